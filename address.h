@@ -0,0 +1,196 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef ADDRESS_H
+#define	ADDRESS_H
+
+#include <stdint.h>
+
+/**
+ * 128-bit IPv6 key, most significant half first
+ */
+typedef struct uint128 {
+	uint64_t high;
+	uint64_t low;
+} uint128;
+
+
+inline bool operator==(const uint128& a, const uint128& b) {
+	return a.high == b.high && a.low == b.low;
+}
+
+inline bool operator!=(const uint128& a, const uint128& b) {
+	return a.high != b.high || a.low != b.low;
+}
+
+inline bool operator<(const uint128& a, const uint128& b) {
+	return a.high < b.high || (a.high == b.high && a.low < b.low);
+}
+
+
+/**
+ * Prefix record as fed to the lookup engines, value is an interned AS index
+ */
+template<typename K>
+struct prefixEntry {
+	K key;
+	unsigned char length;
+	unsigned int value;
+};
+
+/**
+ * Orders by key, ancestors before their descendants
+ */
+template<typename K>
+inline bool prefix_order(const prefixEntry<K>& a, const prefixEntry<K>& b) {
+	return a.key < b.key || (a.key == b.key && a.length < b.length);
+}
+
+
+/*
+ * Key operations shared by the integer lookup engines, overloaded
+ * for uint32_t (IPv4) and uint128 (IPv6). Bit 0 is the most significant.
+ */
+
+inline unsigned int key_width(const uint32_t) {
+	return 32;
+}
+
+inline unsigned int key_width(const uint128&) {
+	return 128;
+}
+
+inline uint32_t key_xor(const uint32_t a, const uint32_t b) {
+	return a ^ b;
+}
+
+inline uint128 key_xor(const uint128& a, const uint128& b) {
+	uint128 r;
+	r.high = a.high ^ b.high;
+	r.low = a.low ^ b.low;
+	return r;
+}
+
+/**
+ * Count of leading zero bits, width of the key when zero
+ */
+inline unsigned int key_clz(const uint32_t key) {
+	return key == 0 ? 32 : __builtin_clz(key);
+}
+
+inline unsigned int key_clz(const uint128& key) {
+	if( key.high != 0 ) {
+		return __builtin_clzll(key.high);
+	}
+
+	return key.low == 0 ? 128 : 64 + __builtin_clzll(key.low);
+}
+
+inline unsigned int key_bit(const uint32_t key, const unsigned int pos) {
+	return (key >> (31 - pos)) & 1;
+}
+
+inline unsigned int key_bit(const uint128& key, const unsigned int pos) {
+	return pos < 64 ? (key.high >> (63 - pos)) & 1 : (key.low >> (127 - pos)) & 1;
+}
+
+/**
+ * Keeps only the first length bits
+ */
+inline uint32_t key_mask(const uint32_t key, const unsigned int length) {
+	return length == 0 ? 0 : key & (0xFFFFFFFFu << (32 - length));
+}
+
+inline uint128 key_mask(const uint128& key, const unsigned int length) {
+	uint128 r;
+	if( length <= 64 ) {
+		r.high = length == 0 ? 0 : key.high & (~0ull << (64 - length));
+		r.low = 0;
+	} else {
+		r.high = key.high;
+		r.low = key.low & (~0ull << (128 - length));
+	}
+	return r;
+}
+
+/**
+ * Returns count bits (1..32) starting at pos, bits past the key end read as zero
+ */
+inline uint32_t key_extract(const uint32_t key, const unsigned int pos, const unsigned int count) {
+	return pos >= 32 ? 0 : (uint32_t)((uint64_t)key << pos) >> (32 - count);
+}
+
+inline uint32_t key_extract(const uint128& key, const unsigned int pos, const unsigned int count) {
+	uint64_t window;
+	if( pos == 0 ) {
+		window = key.high;
+	} else if( pos < 64 ) {
+		window = (key.high << pos) | (key.low >> (64 - pos));
+	} else if( pos < 128 ) {
+		window = key.low << (pos - 64);
+	} else {
+		return 0;
+	}
+
+	return (uint32_t)(window >> (64 - count));
+}
+
+/**
+ * Sets count bits (1..32) starting at pos to value, the bits must be zero before
+ */
+inline uint32_t key_deposit(const uint32_t key, const unsigned int pos, const unsigned int count, const uint32_t value) {
+	return key | (uint32_t)((uint64_t)value << (32 - pos - count));
+}
+
+inline uint128 key_deposit(const uint128& key, const unsigned int pos, const unsigned int count, const uint32_t value) {
+	const unsigned int shift = 128 - pos - count;
+	uint128 r = key;
+
+	if( shift >= 64 ) {
+		r.high |= (uint64_t)value << (shift - 64);
+	} else {
+		r.low |= (uint64_t)value << shift;
+		if( shift + count > 64 ) {
+			r.high |= (uint64_t)value >> (64 - shift);
+		}
+	}
+	return r;
+}
+
+/**
+ * Number of leading bits two keys have in common
+ */
+template<typename K>
+inline unsigned int key_common(const K& a, const K& b) {
+	return key_clz(key_xor(a, b));
+}
+
+/**
+ * Converts '0'/'1' string of given length into key
+ */
+inline void key_from_bits(const char* bits, const unsigned int length, uint32_t& key) {
+	key = 0;
+	for(unsigned int i = 0; i < length; ++i) {
+		key |= (uint32_t)(bits[i] - '0') << (31 - i);
+	}
+}
+
+inline void key_from_bits(const char* bits, const unsigned int length, uint128& key) {
+	key.high = 0;
+	key.low = 0;
+	for(unsigned int i = 0; i < length; ++i) {
+		if( i < 64 ) {
+			key.high |= (uint64_t)(bits[i] - '0') << (63 - i);
+		} else {
+			key.low |= (uint64_t)(bits[i] - '0') << (127 - i);
+		}
+	}
+}
+
+#endif	/* ADDRESS_H */
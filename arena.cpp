@@ -0,0 +1,63 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "arena.h"
+#include <cstring>
+
+const size_t Arena::BLOCK_SIZE;
+const size_t Arena::ALIGN;
+
+
+Arena::Arena() {
+	this->current = NULL;
+	this->used = 0;
+	this->reserved = 0;
+}
+
+Arena::~Arena() {
+	this->clear();
+}
+
+void Arena::clear() {
+	for(unsigned int i = 0; i < this->blocks.size(); ++i) {
+		delete[] this->blocks[i];
+	}
+
+	this->blocks.clear();
+	this->current = NULL;
+	this->used = 0;
+	this->reserved = 0;
+}
+
+/**
+ * Starts a new block, oversized requests get a block of their own
+ */
+void* Arena::allocBlock(const size_t size) {
+	if( size > BLOCK_SIZE ) {
+		char* block = new char[size];
+		this->blocks.push_back(block);
+		this->reserved += size;
+		return block;
+	}
+
+	this->current = new char[BLOCK_SIZE];
+	this->blocks.push_back(this->current);
+	this->reserved += BLOCK_SIZE;
+	this->used = size;
+	return this->current;
+}
+
+/**
+ * Copies data into the arena
+ */
+char* Arena::copy(const char* data, const size_t length) {
+	char* memory = (char*)this->alloc(length);
+	memcpy(memory, data, length);
+	return memory;
+}
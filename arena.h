@@ -0,0 +1,71 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef ARENA_H
+#define	ARENA_H
+
+#include <vector>
+#include <stddef.h>
+
+using std::vector;
+
+/**
+ * Bump allocator for build-time structures
+ *
+ * Memory is carved from large blocks and never freed one by one, clear()
+ * releases everything at once. Only plain data may live in it, no
+ * destructors are run.
+ */
+class Arena {
+
+	public:
+		static const size_t BLOCK_SIZE = 256 * 1024;
+		static const size_t ALIGN = 8;
+
+		Arena();
+		virtual ~Arena();
+
+		void* alloc(size_t size);
+		char* copy(const char* data, const size_t length);
+		void clear();
+		size_t size() const;
+
+	private:
+		Arena(const Arena&);
+		Arena& operator=(const Arena&);
+
+		void* allocBlock(const size_t size);
+
+		vector<char*> blocks;
+		char* current;
+		size_t used;
+		size_t reserved;
+
+};
+
+/**
+ * Returns uninitialized memory aligned to ALIGN
+ */
+inline void* Arena::alloc(size_t size) {
+	size = (size + ALIGN - 1) & ~(ALIGN - 1);
+
+	if( this->current == NULL || this->used + size > BLOCK_SIZE ) {
+		return this->allocBlock(size);
+	}
+
+	void* memory = this->current + this->used;
+	this->used += size;
+	return memory;
+}
+
+inline size_t Arena::size() const {
+	return this->reserved;
+}
+
+#endif	/* ARENA_H */
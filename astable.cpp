@@ -0,0 +1,149 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "astable.h"
+#include <cstring>
+
+const unsigned int AsTable::ENTRY_SIZE;
+const unsigned int AsTable::INITIAL_CAPACITY;
+
+
+AsTable::AsTable() {
+	this->entries = NULL;
+	this->capacity = 0;
+	this->base.store(NULL);
+	this->baseCount.store(0);
+	this->clear();
+}
+
+AsTable::~AsTable() {
+	this->release();
+}
+
+/**
+ * Frees the owned and retired arrays, no reader may be active anymore
+ */
+void AsTable::release() {
+	delete[] this->entries;
+	for(unsigned int i = 0; i < this->retired.size(); ++i) {
+		delete[] this->retired[i];
+	}
+
+	this->entries = NULL;
+	this->capacity = 0;
+	this->retired.clear();
+}
+
+void AsTable::clear() {
+	this->release();
+
+	this->entries = new asEntry[INITIAL_CAPACITY];
+	this->capacity = INITIAL_CAPACITY;
+
+	asEntry& none = this->entries[0];
+	memset(&none, 0, sizeof(none));
+	none.text[0] = '-';
+	none.text[1] = '\n';
+	none.length = 2;
+
+	this->known.clear();
+	this->base.store(this->entries, std::memory_order_release);
+	this->baseCount.store(1, std::memory_order_release);
+}
+
+/**
+ * Makes room for one more entry; the current array stays readable, an
+ * attached one is copied over and indexed
+ */
+void AsTable::grow() {
+	const unsigned int count = this->baseCount.load(std::memory_order_relaxed);
+	if( this->entries != NULL && count < this->capacity ) {
+		return;
+	}
+
+	const bool attached = this->entries == NULL;
+	const unsigned int capacity = count * 2 > INITIAL_CAPACITY ? count * 2 : INITIAL_CAPACITY;
+	asEntry* entries = new asEntry[capacity];
+	memcpy(entries, this->base.load(std::memory_order_relaxed), count * sizeof(asEntry));
+
+	if( attached ) {
+		for(unsigned int i = 1; i < count; ++i) {
+			this->known[entries[i].as] = i;
+		}
+	} else {
+		this->retired.push_back(this->entries);
+	}
+
+	this->entries = entries;
+	this->capacity = capacity;
+	this->base.store(entries, std::memory_order_release);
+}
+
+void AsTable::render(asEntry& entry, const unsigned int as) {
+	char digits[10];
+	unsigned int n = 0;
+	unsigned int rest = as;
+
+	do {
+		digits[n++] = '0' + rest % 10;
+		rest /= 10;
+	} while( rest > 0 );
+
+	memset(&entry, 0, sizeof(entry));
+	for(unsigned int i = 0; i < n; ++i) {
+		entry.text[i] = digits[n - 1 - i];
+	}
+	entry.text[n] = '\n';
+	entry.length = n + 1;
+	entry.as = as;
+}
+
+/**
+ * Returns index of the AS, adding it when seen first; AS 0 is reserved and means no match
+ */
+uint32_t AsTable::intern(const unsigned int as) {
+	if( as == 0 ) {
+		return 0;
+	}
+
+	map<unsigned int, uint32_t>::iterator it = this->known.find(as);
+	if( it != this->known.end() ) {
+		return it->second;
+	}
+
+	// an attached table is indexed on its first copy
+	if( this->entries == NULL ) {
+		this->grow();
+		it = this->known.find(as);
+		if( it != this->known.end() ) {
+			return it->second;
+		}
+	}
+
+	this->grow();
+
+	// written before the count grows, readers never see it half done
+	const uint32_t index = this->baseCount.load(std::memory_order_relaxed);
+	this->render(this->entries[index], as);
+	this->known[as] = index;
+	this->baseCount.store(index + 1, std::memory_order_release);
+
+	return index;
+}
+
+/**
+ * Uses external entries (e.g. mapped snapshot), which must outlive the table;
+ * the entries are never written, the first intern() copies them
+ */
+void AsTable::attach(const asEntry* entries, const unsigned int count) {
+	this->release();
+	this->known.clear();
+	this->base.store(entries, std::memory_order_release);
+	this->baseCount.store(count, std::memory_order_release);
+}
@@ -0,0 +1,99 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef ASTABLE_H
+#define	ASTABLE_H
+
+#include <vector>
+#include <map>
+#include <atomic>
+#include <stdint.h>
+
+using std::vector;
+using std::map;
+
+/**
+ * AS number with its pre-rendered output line ("64512\n")
+ *
+ * Exactly 16 bytes so the output formatter can always copy the whole
+ * entry and advance by length.
+ */
+typedef struct asEntry {
+	char text[11];
+	unsigned char length;
+	uint32_t as;
+} asEntry;
+
+/**
+ * Interned AS numbers
+ *
+ * Lookup engines store the index into this table instead of the AS
+ * itself. Index 0 is reserved for "no match" and renders as "-". Like
+ * the trie nodes, the entries can be attached read-only from a snapshot.
+ *
+ * Entries never move while the table is in use: a full array is copied
+ * into one twice as large, published, and the old one is kept until
+ * clear(). Readers may therefore query the table while a single writer
+ * interns, as long as the writer publishes an index only after intern()
+ * returned it. Interning into an attached table copies it first.
+ */
+class AsTable {
+
+	public:
+		static const unsigned int ENTRY_SIZE = sizeof(asEntry);
+		static const unsigned int INITIAL_CAPACITY = 64;
+
+		AsTable();
+		virtual ~AsTable();
+
+		uint32_t intern(const unsigned int as);
+		void attach(const asEntry* entries, const unsigned int count);
+		void clear();
+
+		const asEntry& entry(const uint32_t index) const;
+		unsigned int as(const uint32_t index) const;
+		const asEntry* data() const;
+		unsigned int count() const;
+
+	private:
+		AsTable(const AsTable&);
+		AsTable& operator=(const AsTable&);
+
+		void render(asEntry& entry, const unsigned int as);
+		void grow();
+		void release();
+
+		/** Owned array, NULL while attached */
+		asEntry* entries;
+		unsigned int capacity;
+		vector<asEntry*> retired;
+
+		map<unsigned int, uint32_t> known;
+		std::atomic<const asEntry*> base;
+		std::atomic<unsigned int> baseCount;
+
+};
+
+inline const asEntry& AsTable::entry(const uint32_t index) const {
+	return this->base.load(std::memory_order_acquire)[index];
+}
+
+inline unsigned int AsTable::as(const uint32_t index) const {
+	return this->base.load(std::memory_order_acquire)[index].as;
+}
+
+inline const asEntry* AsTable::data() const {
+	return this->base.load(std::memory_order_acquire);
+}
+
+inline unsigned int AsTable::count() const {
+	return this->baseCount.load(std::memory_order_acquire);
+}
+
+#endif	/* ASTABLE_H */
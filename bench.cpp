@@ -0,0 +1,500 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#define EXIT_HELP 2
+
+#define TIMING_BATCH 64
+#define NEST_PERMILLE 300
+#define ZIPF_FLOWS 100000
+#define MISS_ATTEMPTS 64
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif //WIN32
+
+// std
+#include <stdlib.h>
+#include <stdio.h>
+
+// string
+#include <cstring>
+#include <string>
+
+// data structures
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include "address.h"
+#include "patricia.h"
+#include "astable.h"
+#include "snapshot.h"
+#include "engines.h"
+
+using namespace std;
+
+/**
+ * Prefix length distributions of the generated tables, in permille,
+ * roughly those of the public BGP tables
+ */
+typedef struct lengthShare {
+	unsigned char length;
+	unsigned int permille;
+} lengthShare;
+
+static const lengthShare LENGTHS4[] = {
+	{8, 1}, {12, 1}, {13, 2}, {14, 4}, {15, 8}, {16, 14}, {17, 9}, {18, 15},
+	{19, 28}, {20, 45}, {21, 48}, {22, 110}, {23, 85}, {24, 630}, {0, 0}
+};
+
+static const lengthShare LENGTHS6[] = {
+	{16, 1}, {19, 1}, {20, 2}, {24, 3}, {28, 6}, {29, 40}, {30, 4}, {32, 120},
+	{33, 6}, {34, 6}, {35, 4}, {36, 30}, {40, 60}, {44, 80}, {45, 6}, {46, 14},
+	{47, 20}, {48, 560}, {56, 20}, {64, 17}, {0, 0}
+};
+
+static const char* ENGINES[] = { "patricia", "dir248", "poptrie", "live", "compact", "compact-bfs", "lctrie", NULL };
+static const char* TRAFFIC[] = { "uniform", "zipf", "scan", "miss", NULL };
+
+
+/**
+ * xorshift64* generator, the same seed gives the same tables and
+ * traffic everywhere
+ */
+class Random {
+
+	public:
+		Random(const uint64_t seed) {
+			this->state = seed * 0x9E3779B97F4A7C15ull + 1;
+		}
+
+		uint64_t next() {
+			this->state ^= this->state >> 12;
+			this->state ^= this->state << 25;
+			this->state ^= this->state >> 27;
+			return this->state * 0x2545F4914F6CDD1Dull;
+		}
+
+		uint32_t below(const uint32_t limit) {
+			return (uint32_t)(((this->next() >> 32) * limit) >> 32);
+		}
+
+		double uniform() {
+			return (this->next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+	private:
+		uint64_t state;
+
+};
+
+/**
+ * Random unicast address: 1.0.0.0 - 223.255.255.255, 2000::/3
+ */
+void random_key(Random& random, uint32_t& key) {
+	key = ((1 + random.below(223)) << 24) | (uint32_t)(random.next() >> 40);
+}
+
+void random_key(Random& random, uint128& key) {
+	key.high = (random.next() >> 3) | 0x2000000000000000ull;
+	key.low = random.next();
+}
+
+/**
+ * Random address inside the prefix
+ */
+template<typename K>
+K random_host(Random& random, const prefixEntry<K>& prefix) {
+	K host;
+	random_key(random, host);
+	return key_xor(prefix.key, key_xor(host, key_mask(host, prefix.length)));
+}
+
+inline void key_increment(uint32_t& key) {
+	key++;
+}
+
+inline void key_increment(uint128& key) {
+	if( ++key.low == 0 ) {
+		key.high++;
+	}
+}
+
+/**
+ * Monotonic time in nanoseconds
+ */
+double getNanos() {
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return counter.QuadPart * 1e9 / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+#endif
+}
+
+bool listed(const vector<string>& list, const string& name) {
+	return find(list.begin(), list.end(), name) != list.end();
+}
+
+vector<string> split(const char* text) {
+	vector<string> parts;
+	const char* comma;
+
+	while( (comma = strchr(text, ',')) != NULL ) {
+		parts.push_back(string(text, comma - text));
+		text = comma + 1;
+	}
+	parts.push_back(string(text));
+
+	return parts;
+}
+
+
+/**
+ * Mapping files are not sorted, neither are the generated tables
+ */
+template<typename K>
+void random_shuffle_entries(Random& random, vector<prefixEntry<K> >& prefixes) {
+	for(unsigned int i = prefixes.size(); i > 1; --i) {
+		swap(prefixes[i - 1], prefixes[random.below(i)]);
+	}
+}
+
+/**
+ * Generates count distinct prefixes, about NEST_PERMILLE of them more
+ * specifics of an earlier one; values are interned from a pool of ASNs
+ */
+template<typename K>
+void generateTable(Random& random, const lengthShare* lengths, const unsigned int count, vector<prefixEntry<K> >& prefixes, AsTable& table) {
+	const unsigned int pool = count / 8 > 70000 ? 70000 : count / 8 + 1;
+	vector<unsigned int> asns(pool);
+	for(unsigned int i = 0; i < pool; ++i) {
+		asns[i] = 1 + random.below(400000);
+	}
+
+	prefixes.clear();
+	while( prefixes.size() < count ) {
+		for(unsigned int i = prefixes.size(); i < count; ++i) {
+			prefixEntry<K> entry;
+
+			unsigned int pick = random.below(1000);
+			unsigned int l = 0;
+			while( pick >= lengths[l].permille ) {
+				pick -= lengths[l++].permille;
+			}
+			entry.length = lengths[l].length;
+
+			const prefixEntry<K>* parent = prefixes.empty() ? NULL : &prefixes[random.below(prefixes.size())];
+			if( parent != NULL && parent->length < entry.length && random.below(1000) < NEST_PERMILLE ) {
+				entry.key = key_mask(random_host(random, *parent), entry.length);
+			} else {
+				random_key(random, entry.key);
+				entry.key = key_mask(entry.key, entry.length);
+			}
+
+			entry.value = table.intern(asns[random.below(pool)]);
+			prefixes.push_back(entry);
+		}
+
+		// duplicates are dropped and generated again
+		sort(prefixes.begin(), prefixes.end(), prefix_order<K>);
+		unsigned int unique = 0;
+		for(unsigned int i = 0; i < prefixes.size(); ++i) {
+			if( unique == 0 || prefixes[unique - 1].key != prefixes[i].key || prefixes[unique - 1].length != prefixes[i].length ) {
+				prefixes[unique++] = prefixes[i];
+			}
+		}
+		prefixes.resize(unique);
+	}
+
+	random_shuffle_entries(random, prefixes);
+}
+
+/**
+ * Generates count query addresses of the given pattern:
+ *  uniform ... random unicast addresses
+ *  zipf    ... ZIPF_FLOWS hosts inside random prefixes, popularity ~ 1/rank
+ *  scan    ... consecutive addresses from a random host up
+ *  miss    ... random addresses no prefix covers, hosts of prefixes once the
+ *              attempts run out (dense tables)
+ */
+template<typename K>
+void generateTraffic(Random& random, const string& pattern, const unsigned int count, const vector<prefixEntry<K> >& prefixes, const PatriciaTrie<K>& reference, vector<K>& queries) {
+	queries.resize(count);
+
+	if( pattern == "uniform" ) {
+		for(unsigned int i = 0; i < count; ++i) {
+			random_key(random, queries[i]);
+		}
+	} else if( pattern == "zipf" ) {
+		const unsigned int flows = prefixes.size() < ZIPF_FLOWS ? prefixes.size() : ZIPF_FLOWS;
+		vector<K> hosts(flows);
+		vector<double> cdf(flows);
+		double sum = 0;
+
+		for(unsigned int i = 0; i < flows; ++i) {
+			hosts[i] = random_host(random, prefixes[random.below(prefixes.size())]);
+			sum += 1.0 / (i + 1);
+			cdf[i] = sum;
+		}
+		for(unsigned int i = 0; i < count; ++i) {
+			const unsigned int rank = lower_bound(cdf.begin(), cdf.end(), random.uniform() * sum) - cdf.begin();
+			queries[i] = hosts[rank < flows ? rank : flows - 1];
+		}
+	} else if( pattern == "scan" ) {
+		K key = random_host(random, prefixes[random.below(prefixes.size())]);
+		for(unsigned int i = 0; i < count; ++i) {
+			queries[i] = key;
+			key_increment(key);
+		}
+	} else {
+		for(unsigned int i = 0; i < count; ++i) {
+			unsigned int attempt = 0;
+			do {
+				random_key(random, queries[i]);
+			} while( reference.find(queries[i]) != 0 && ++attempt < MISS_ATTEMPTS );
+
+			if( attempt == MISS_ATTEMPTS ) {
+				queries[i] = random_host(random, prefixes[random.below(prefixes.size())]);
+			}
+		}
+	}
+}
+
+
+/**
+ * Times findBatch over TIMING_BATCH long slices of the queries, repeats
+ * times; the per-lookup time of every slice is one sample
+ * @return number of results differing from the reference answers
+ */
+template<typename K>
+unsigned int measureLookups(const LookupEngine<K>* engine, const vector<K>& queries, const vector<unsigned int>& expected, const unsigned int repeats, double& median, double& p99) {
+	vector<unsigned int> results(queries.size());
+	vector<double> samples;
+	samples.reserve(repeats * (queries.size() / TIMING_BATCH + 1));
+
+	for(unsigned int r = 0; r < repeats; ++r) {
+		for(unsigned int i = 0; i < queries.size(); i += TIMING_BATCH) {
+			const unsigned int count = queries.size() - i < TIMING_BATCH ? queries.size() - i : TIMING_BATCH;
+			const double start = getNanos();
+			engine->findBatch(&queries[i], &results[i], count);
+			samples.push_back((getNanos() - start) / count);
+		}
+	}
+
+	unsigned int errors = 0;
+	for(unsigned int i = 0; i < queries.size(); ++i) {
+		if( results[i] != expected[i] ) {
+			errors++;
+		}
+	}
+
+	if( samples.empty() ) {
+		median = p99 = 0;
+	} else {
+		sort(samples.begin(), samples.end());
+		median = samples[samples.size() / 2];
+		p99 = samples[(samples.size() - 1) * 99 / 100];
+	}
+
+	return errors;
+}
+
+/**
+ * Creates an empty file for a snapshot in the temporary directory, unique
+ * to this run
+ * @return empty string on failure
+ */
+string temporary_path(const unsigned int family) {
+#ifdef _WIN32
+	char name[L_tmpnam];
+	return tmpnam(name) != NULL ? string(name) : string();
+#else
+	const char* directory = getenv("TMPDIR");
+	string path = string(directory != NULL && *directory != '\0' ? directory : "/tmp") + "/lpm-bench.tree" + (family == 4 ? "4" : "6") + ".XXXXXX";
+	const int fd = mkstemp(&path[0]);
+	if( fd < 0 ) {
+		return string();
+	}
+	close(fd);
+	return path;
+#endif //WIN32
+}
+
+/**
+ * Runs every selected engine and traffic pattern over one generated table
+ */
+template<typename K>
+void benchFamily(LookupEngine<K>* (*create)(const string&), const lengthShare* lengths, const unsigned int size, const vector<string>& engines, const vector<string>& patterns, const unsigned int queryCount, const unsigned int repeats, const uint64_t seed) {
+	const unsigned int family = key_width(K()) == 32 ? 4 : 6;
+	const string path = temporary_path(family);
+	if( path.empty() ) {
+		fprintf(stderr, "Cannot create temporary snapshot file\n");
+		return;
+	}
+	Random random(seed * 2 + family);
+
+	// table, its snapshot and reference answers
+	vector<prefixEntry<K> > prefixes;
+	AsTable table;
+	generateTable(random, lengths, size, prefixes, table);
+
+	PatriciaTrie<K> reference;
+	reference.build(prefixes);
+	if( !snapshot_save(path, reference, table) ) {
+		fprintf(stderr, "Cannot write snapshot %s\n", path.c_str());
+		remove(path.c_str());
+		return;
+	}
+
+	vector<vector<K> > traffic(patterns.size());
+	vector<vector<unsigned int> > expected(patterns.size());
+	for(unsigned int p = 0; p < patterns.size(); ++p) {
+		generateTraffic(random, patterns[p], queryCount, prefixes, reference, traffic[p]);
+		expected[p].resize(queryCount);
+		reference.findBatch(&traffic[p][0], &expected[p][0], queryCount);
+	}
+
+	for(unsigned int e = 0; e < engines.size(); ++e) {
+		LookupEngine<K>* engine = create(engines[e]);
+		if( engine == NULL ) {
+			continue;
+		}
+
+		// build from the unsorted prefix list
+		double start = getNanos();
+		engine->build(prefixes);
+		const double buildTime = getNanos() - start;
+		delete engine;
+
+		// load the way lpm does: map the snapshot, build the engine from it
+		Snapshot snapshot;
+		PatriciaTrie<K> trie;
+		AsTable loaded;
+		start = getNanos();
+		if( !snapshot_load(snapshot, path, trie, loaded, false) ) {
+			fprintf(stderr, "Cannot load snapshot %s\n", path.c_str());
+			remove(path.c_str());
+			return;
+		}
+		engine = create(engines[e]);
+		if( dynamic_cast<PatriciaTrie<K>*>(engine) == NULL ) {
+			vector<prefixEntry<K> > stored;
+			trie.prefixes(stored);
+			engine->build(stored);
+		}
+		const double loadTime = getNanos() - start;
+		const LookupEngine<K>* used = dynamic_cast<PatriciaTrie<K>*>(engine) == NULL ? engine : &trie;
+
+		for(unsigned int p = 0; p < patterns.size(); ++p) {
+			double median, p99;
+			const unsigned int errors = measureLookups(used, traffic[p], expected[p], repeats, median, p99);
+
+			printf("IPv%u\t%u\t%-12s\t%.3f\t%.3f\t%.1f\t%-8s\t%.1f\t%.1f\t%u\n",
+				family, size, engines[e].c_str(), buildTime / 1e6, loadTime / 1e6,
+				(double)used->size() / size, patterns[p].c_str(), median, p99, errors);
+			fflush(stdout);
+		}
+
+		delete engine;
+	}
+
+	remove(path.c_str());
+}
+
+
+/**
+ * Prints help message onto stderr
+ */
+void printHelp(void) {
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "\tlpm-bench [options]\t\t\t... benchmark the lookup engines\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t-n N[,N...]\t\t\t\t... table sizes (default 10000,100000,1000000)\n");
+	fprintf(stderr, "\t-f 4|6\t\t\t\t\t... one address family only\n");
+	fprintf(stderr, "\t-e ENGINE[,ENGINE...]\t\t\t... engines as for lpm -e (default all)\n");
+	fprintf(stderr, "\t-t PATTERN[,PATTERN...]\t\t\t... traffic: uniform, zipf, scan, miss (default all)\n");
+	fprintf(stderr, "\t-q N\t\t\t\t\t... queries per pattern (default 1000000)\n");
+	fprintf(stderr, "\t-r N\t\t\t\t\t... timed passes over the queries (default 3)\n");
+	fprintf(stderr, "\t-s SEED\t\t\t\t\t... generator seed (default 1)\n");
+}
+
+/*
+ * Run benchmark
+ */
+int main(int argc, char** argv) {
+	vector<string> sizes = split("10000,100000,1000000");
+	vector<string> engines(ENGINES, ENGINES + sizeof(ENGINES) / sizeof(ENGINES[0]) - 1);
+	vector<string> patterns(TRAFFIC, TRAFFIC + sizeof(TRAFFIC) / sizeof(TRAFFIC[0]) - 1);
+	unsigned int family = 0;
+	unsigned int queryCount = 1000000;
+	unsigned int repeats = 3;
+	uint64_t seed = 1;
+
+	for(int a = 1; a < argc; ++a) {
+		if( a + 1 >= argc ) {
+			printHelp();
+			return EXIT_HELP;
+		} else if( strcmp(argv[a], "-n") == 0 ) {
+			sizes = split(argv[++a]);
+		} else if( strcmp(argv[a], "-f") == 0 ) {
+			family = atoi(argv[++a]);
+		} else if( strcmp(argv[a], "-e") == 0 ) {
+			engines = split(argv[++a]);
+		} else if( strcmp(argv[a], "-t") == 0 ) {
+			patterns = split(argv[++a]);
+		} else if( strcmp(argv[a], "-q") == 0 ) {
+			queryCount = atoi(argv[++a]);
+		} else if( strcmp(argv[a], "-r") == 0 ) {
+			repeats = atoi(argv[++a]);
+		} else if( strcmp(argv[a], "-s") == 0 ) {
+			seed = strtoull(argv[++a], NULL, 10);
+		} else {
+			printHelp();
+			return EXIT_HELP;
+		}
+	}
+
+	const vector<string> known(TRAFFIC, TRAFFIC + sizeof(TRAFFIC) / sizeof(TRAFFIC[0]) - 1);
+	for(unsigned int p = 0; p < patterns.size(); ++p) {
+		if( !listed(known, patterns[p]) ) {
+			printHelp();
+			return EXIT_HELP;
+		}
+	}
+	if( queryCount == 0 || repeats == 0 || (family != 0 && family != 4 && family != 6) ) {
+		printHelp();
+		return EXIT_HELP;
+	}
+
+	printf("family\tprefixes\tengine      \tbuild ms\tload ms\tB/prefix\ttraffic \tmedian ns\tp99 ns\terrors\n");
+
+	for(unsigned int s = 0; s < sizes.size(); ++s) {
+		const unsigned int size = atoi(sizes[s].c_str());
+		if( size == 0 ) {
+			continue;
+		}
+
+		if( family != 6 ) {
+			benchFamily<uint32_t>(createEngine4, LENGTHS4, size, engines, patterns, queryCount, repeats, seed + s);
+		}
+		if( family != 4 ) {
+			benchFamily<uint128>(createEngine6, LENGTHS6, size, engines, patterns, queryCount, repeats, seed + s);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef CACHE_H
+#define	CACHE_H
+
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include "address.h"
+#include "engine.h"
+
+using std::vector;
+
+inline uint32_t flow_hash(const uint32_t key) {
+	return (uint32_t)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+inline uint32_t flow_hash(const uint128& key) {
+	return (uint32_t)(((key.high ^ (key.low * 0xC2B2AE3D27D4EB4Full)) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+/**
+ * Set-associative cache of lookup results for one thread
+ *
+ * Meant for skewed traffic where few addresses repeat a lot. Entries carry
+ * the cache generation they were stored in, so invalidate() - called
+ * whenever the engine reports a new table generation - is O(1). Victims
+ * are picked by CLOCK (a reference bit and a hand per set) or exact LRU
+ * over the ways of the set.
+ */
+template<typename K>
+class FlowCache {
+
+	public:
+		static const unsigned int WAYS = 4;
+
+		enum replacement { REPLACE_CLOCK, REPLACE_LRU };
+
+		FlowCache(const unsigned int entries, const replacement policy);
+
+		bool find(const K& key, unsigned int& value);
+		void insert(const K& key, const unsigned int value);
+		void lookup(const LookupEngine<K>* engine, const K* keys, unsigned int* results, const unsigned int count);
+
+		void sync(const uint64_t tableGeneration);
+		void invalidate();
+
+		unsigned long long hits() const;
+		unsigned long long misses() const;
+		unsigned int capacity() const;
+
+	private:
+		typedef struct cacheSet {
+			K keys[WAYS];
+			uint32_t values[WAYS];
+			uint32_t generations[WAYS];
+			unsigned char ages[WAYS];
+			unsigned char hand;
+		} cacheSet;
+
+		void touch(cacheSet& set, const unsigned int way);
+		unsigned int victim(cacheSet& set);
+
+		vector<cacheSet> sets;
+		uint32_t mask;
+		uint32_t generation;
+		uint64_t tableGeneration;
+		replacement policy;
+
+		unsigned long long _hits;
+		unsigned long long _misses;
+
+};
+
+
+/**
+ * @param entries rounded up to whole power of two number of sets
+ */
+template<typename K>
+FlowCache<K>::FlowCache(const unsigned int entries, const replacement policy) {
+	unsigned int count = 1;
+	while( count * WAYS < entries ) {
+		count <<= 1;
+	}
+
+	cacheSet empty;
+	memset(&empty, 0, sizeof(empty));
+	for(unsigned int w = 0; w < WAYS; ++w) {
+		empty.ages[w] = w;
+	}
+
+	this->sets.assign(count, empty);
+	this->mask = count - 1;
+	this->generation = 1;
+	this->tableGeneration = 0;
+	this->policy = policy;
+	this->_hits = 0;
+	this->_misses = 0;
+}
+
+template<typename K>
+inline unsigned long long FlowCache<K>::hits() const {
+	return this->_hits;
+}
+
+template<typename K>
+inline unsigned long long FlowCache<K>::misses() const {
+	return this->_misses;
+}
+
+template<typename K>
+inline unsigned int FlowCache<K>::capacity() const {
+	return this->sets.size() * WAYS;
+}
+
+template<typename K>
+void FlowCache<K>::invalidate() {
+	if( ++this->generation == 0 ) {
+		for(unsigned int i = 0; i < this->sets.size(); ++i) {
+			memset(this->sets[i].generations, 0, sizeof(this->sets[i].generations));
+		}
+		this->generation = 1;
+	}
+}
+
+/**
+ * Drops everything when the table changed since the last call
+ */
+template<typename K>
+inline void FlowCache<K>::sync(const uint64_t tableGeneration) {
+	if( tableGeneration != this->tableGeneration ) {
+		this->tableGeneration = tableGeneration;
+		this->invalidate();
+	}
+}
+
+/**
+ * LRU keeps ages a permutation of 0..WAYS-1, CLOCK only a reference bit
+ */
+template<typename K>
+inline void FlowCache<K>::touch(cacheSet& set, const unsigned int way) {
+	if( this->policy == REPLACE_CLOCK ) {
+		set.ages[way] = 1;
+		return;
+	}
+
+	for(unsigned int w = 0; w < WAYS; ++w) {
+		if( set.ages[w] < set.ages[way] ) {
+			set.ages[w]++;
+		}
+	}
+	set.ages[way] = 0;
+}
+
+template<typename K>
+inline unsigned int FlowCache<K>::victim(cacheSet& set) {
+	for(unsigned int w = 0; w < WAYS; ++w) {
+		if( set.generations[w] != this->generation ) {
+			return w;
+		}
+	}
+
+	if( this->policy == REPLACE_LRU ) {
+		unsigned int oldest = 0;
+		for(unsigned int w = 1; w < WAYS; ++w) {
+			if( set.ages[w] > set.ages[oldest] ) {
+				oldest = w;
+			}
+		}
+		return oldest;
+	}
+
+	// second chance for referenced ways
+	while( set.ages[set.hand] != 0 ) {
+		set.ages[set.hand] = 0;
+		set.hand = (set.hand + 1) % WAYS;
+	}
+
+	const unsigned int way = set.hand;
+	set.hand = (set.hand + 1) % WAYS;
+	return way;
+}
+
+template<typename K>
+inline bool FlowCache<K>::find(const K& key, unsigned int& value) {
+	cacheSet& set = this->sets[flow_hash(key) & this->mask];
+
+	for(unsigned int w = 0; w < WAYS; ++w) {
+		if( set.generations[w] == this->generation && set.keys[w] == key ) {
+			value = set.values[w];
+			this->touch(set, w);
+			this->_hits++;
+			return true;
+		}
+	}
+
+	this->_misses++;
+	return false;
+}
+
+template<typename K>
+inline void FlowCache<K>::insert(const K& key, const unsigned int value) {
+	cacheSet& set = this->sets[flow_hash(key) & this->mask];
+	unsigned int way = WAYS;
+
+	// the same key may miss twice within one batch
+	for(unsigned int w = 0; w < WAYS; ++w) {
+		if( set.generations[w] == this->generation && set.keys[w] == key ) {
+			way = w;
+		}
+	}
+	if( way == WAYS ) {
+		way = this->victim(set);
+	}
+
+	set.keys[way] = key;
+	set.values[way] = value;
+	set.generations[way] = this->generation;
+	this->touch(set, way);
+}
+
+/**
+ * Answers keys from the cache, the misses go to the engine in one batch
+ */
+template<typename K>
+void FlowCache<K>::lookup(const LookupEngine<K>* engine, const K* keys, unsigned int* results, const unsigned int count) {
+	K missed[BATCH_GROUP];
+	unsigned int positions[BATCH_GROUP];
+	unsigned int found[BATCH_GROUP];
+
+	this->sync(engine->generation());
+
+	for(unsigned int group = 0; group < count; group += BATCH_GROUP) {
+		const unsigned int size = count - group < BATCH_GROUP ? count - group : BATCH_GROUP;
+		unsigned int misses = 0;
+
+		for(unsigned int i = group; i < group + size; ++i) {
+			if( !this->find(keys[i], results[i]) ) {
+				missed[misses] = keys[i];
+				positions[misses++] = i;
+			}
+		}
+
+		engine->findBatch(missed, found, misses);
+
+		for(unsigned int i = 0; i < misses; ++i) {
+			results[positions[i]] = found[i];
+			this->insert(missed[i], found[i]);
+		}
+	}
+}
+
+#endif	/* CACHE_H */
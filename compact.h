@@ -0,0 +1,348 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef COMPACT_H
+#define	COMPACT_H
+
+#include <vector>
+#include <exception>
+#include <stdint.h>
+#include "address.h"
+#include "engine.h"
+#include "patricia.h"
+
+using std::vector;
+using std::exception;
+
+/**
+ * Read-only path-compressed trie packed into 16-byte nodes
+ *
+ * A node keeps only the bits of its incoming edge (the skip bits), not
+ * the whole prefix: up to 32 of them inline, longer labels out-of-line
+ * in a word array. Length and value share one word, children are 32-bit
+ * indices, there is no parent link. Four nodes fit a cache line.
+ *
+ * Nodes are ordered either breadth-first or in van Emde Boas layout, in
+ * which every subtree of about half the height is stored contiguously, so
+ * a lookup touches roughly one cache line per few levels whatever the
+ * line size is.
+ */
+template<typename K>
+class CompactTrie : public LookupEngine<K> {
+
+	public:
+		static const uint32_t NONE = 0xFFFFFFFF;
+		static const uint32_t VALUE_MASK = 0x00FFFFFF;
+		static const unsigned int LENGTH_SHIFT = 24;
+
+		enum nodeOrder { ORDER_BFS, ORDER_VEB };
+
+		typedef struct compactNode {
+			uint32_t children[2];
+			uint32_t bits;
+			uint32_t info;
+		} compactNode;
+
+		CompactTrie(const nodeOrder order);
+
+		void build(const vector<prefixEntry<K> >& prefixes);
+		unsigned int find(const K& key) const;
+		void findBatch(const K* keys, unsigned int* results, const unsigned int count) const;
+		unsigned int trace(const K& key, unsigned int& depth) const;
+
+		const char* name() const;
+		unsigned int size() const;
+
+	private:
+		bool matches(const compactNode& n, const K& key, const unsigned int pos) const;
+
+		void layoutBfs(const PatriciaTrie<K>& trie, vector<uint32_t>& order) const;
+		void layoutVeb(const PatriciaTrie<K>& trie, const uint32_t index, const unsigned int height, vector<uint32_t>& order, vector<uint32_t>& bottoms) const;
+		unsigned int height(const PatriciaTrie<K>& trie, const uint32_t index) const;
+
+		nodeOrder order;
+		vector<compactNode, HugeAllocator<compactNode> > nodes;
+		vector<uint32_t, HugeAllocator<uint32_t> > labels;
+
+};
+
+
+template<typename K>
+CompactTrie<K>::CompactTrie(const nodeOrder order) {
+	this->order = order;
+}
+
+template<typename K>
+inline const char* CompactTrie<K>::name() const {
+	return this->order == ORDER_VEB ? "compact" : "compact-bfs";
+}
+
+template<typename K>
+inline unsigned int CompactTrie<K>::size() const {
+	return this->nodes.size() * sizeof(compactNode) + this->labels.size() * sizeof(uint32_t);
+}
+
+/**
+ * Compares the edge label of n starting at bit pos with the key
+ */
+template<typename K>
+inline bool CompactTrie<K>::matches(const compactNode& n, const K& key, const unsigned int pos) const {
+	const unsigned int count = (n.info >> LENGTH_SHIFT) - pos;
+
+	if( count == 0 ) {
+		return true;
+	} else if( count <= 32 ) {
+		return key_extract(key, pos, count) == n.bits >> (32 - count);
+	}
+
+	for(unsigned int offset = 0; offset < count; offset += 32) {
+		const unsigned int width = count - offset < 32 ? count - offset : 32;
+		if( key_extract(key, pos + offset, width) != this->labels[n.bits + offset / 32] >> (32 - width) ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template<typename K>
+unsigned int CompactTrie<K>::find(const K& key) const {
+	const compactNode* nodes = &this->nodes[0];
+	const unsigned int width = key_width(key);
+	unsigned int best = 0;
+	unsigned int pos = 0;
+	uint32_t current = 0;
+
+	do {
+		const compactNode& n = nodes[current];
+
+		if( !this->matches(n, key, pos) ) {
+			break;
+		}
+
+		if( n.info & VALUE_MASK ) {
+			best = n.info & VALUE_MASK;
+		}
+
+		pos = n.info >> LENGTH_SHIFT;
+		if( pos == width ) {
+			break;
+		}
+
+		current = n.children[key_bit(key, pos)];
+	} while( current != NONE );
+
+	return best;
+}
+
+template<typename K>
+unsigned int CompactTrie<K>::trace(const K& key, unsigned int& depth) const {
+	const unsigned int width = key_width(key);
+	unsigned int visited = 0;
+	uint32_t current = 0;
+
+	depth = 0;
+	do {
+		const compactNode& n = this->nodes[current];
+		visited++;
+
+		if( !this->matches(n, key, depth) ) {
+			break;
+		}
+
+		depth = n.info >> LENGTH_SHIFT;
+		if( depth == width ) {
+			break;
+		}
+
+		current = n.children[key_bit(key, depth)];
+	} while( current != NONE );
+
+	return visited;
+}
+
+template<typename K>
+void CompactTrie<K>::findBatch(const K* keys, unsigned int* results, const unsigned int count) const {
+	const compactNode* nodes = &this->nodes[0];
+	const unsigned int width = key_width(K());
+	uint32_t current[BATCH_GROUP];
+	unsigned int pos[BATCH_GROUP];
+
+	for(unsigned int group = 0; group < count; group += BATCH_GROUP) {
+		const unsigned int size = count - group < BATCH_GROUP ? count - group : BATCH_GROUP;
+		const K* key = keys + group;
+		unsigned int* best = results + group;
+		unsigned int active = size;
+
+		for(unsigned int i = 0; i < size; ++i) {
+			current[i] = 0;
+			pos[i] = 0;
+			best[i] = 0;
+		}
+
+		// one step of every lookup per round, next nodes are prefetched meanwhile
+		while( active > 0 ) {
+			active = 0;
+
+			for(unsigned int i = 0; i < size; ++i) {
+				if( current[i] == NONE ) {
+					continue;
+				}
+
+				const compactNode& n = nodes[current[i]];
+
+				if( !this->matches(n, key[i], pos[i]) ) {
+					current[i] = NONE;
+					continue;
+				}
+
+				if( n.info & VALUE_MASK ) {
+					best[i] = n.info & VALUE_MASK;
+				}
+
+				pos[i] = n.info >> LENGTH_SHIFT;
+				if( pos[i] == width ) {
+					current[i] = NONE;
+					continue;
+				}
+
+				current[i] = n.children[key_bit(key[i], pos[i])];
+				if( current[i] != NONE ) {
+					PREFETCH(&nodes[current[i]]);
+					active++;
+				}
+			}
+		}
+	}
+}
+
+
+/**
+ * Packs the Patricia trie of the prefixes in the selected order
+ */
+template<typename K>
+void CompactTrie<K>::build(const vector<prefixEntry<K> >& prefixes) {
+	PatriciaTrie<K> trie;
+	trie.build(prefixes);
+
+	const typename PatriciaTrie<K>::patriciaNode* source = trie.data();
+	const unsigned int count = trie.nodeCount();
+
+	// new position of every node
+	vector<uint32_t> order;
+	order.reserve(count);
+	if( this->order == ORDER_VEB ) {
+		vector<uint32_t> bottoms;
+		this->layoutVeb(trie, 0, this->height(trie, 0), order, bottoms);
+	} else {
+		this->layoutBfs(trie, order);
+	}
+
+	vector<uint32_t> position(count);
+	vector<unsigned char> parentLength(count, 0);
+	for(unsigned int i = 0; i < count; ++i) {
+		position[order[i]] = i;
+		for(unsigned int c = 0; c < 2; ++c) {
+			if( source[order[i]].children[c] != PatriciaTrie<K>::NONE ) {
+				parentLength[source[order[i]].children[c]] = source[order[i]].length;
+			}
+		}
+	}
+
+	this->nodes.assign(count, compactNode());
+	this->labels.clear();
+
+	for(unsigned int i = 0; i < count; ++i) {
+		const typename PatriciaTrie<K>::patriciaNode& s = source[order[i]];
+		compactNode& n = this->nodes[i];
+
+		if( s.value > VALUE_MASK ) {
+			throw exception();
+		}
+
+		for(unsigned int c = 0; c < 2; ++c) {
+			n.children[c] = s.children[c] == PatriciaTrie<K>::NONE ? NONE : position[s.children[c]];
+		}
+		n.info = ((uint32_t)s.length << LENGTH_SHIFT) | s.value;
+
+		// skip bits from the parent branching bit on
+		const unsigned int pos = parentLength[order[i]];
+		const unsigned int skip = s.length - pos;
+
+		if( skip == 0 ) {
+			n.bits = 0;
+		} else if( skip <= 32 ) {
+			n.bits = key_extract(s.prefix, pos, skip) << (32 - skip);
+		} else {
+			n.bits = this->labels.size();
+			for(unsigned int offset = 0; offset < skip; offset += 32) {
+				const unsigned int width = skip - offset < 32 ? skip - offset : 32;
+				this->labels.push_back(key_extract(s.prefix, pos + offset, width) << (32 - width));
+			}
+		}
+	}
+}
+
+template<typename K>
+void CompactTrie<K>::layoutBfs(const PatriciaTrie<K>& trie, vector<uint32_t>& order) const {
+	const typename PatriciaTrie<K>::patriciaNode* source = trie.data();
+
+	order.push_back(0);
+	for(unsigned int i = 0; i < order.size(); ++i) {
+		for(unsigned int c = 0; c < 2; ++c) {
+			if( source[order[i]].children[c] != PatriciaTrie<K>::NONE ) {
+				order.push_back(source[order[i]].children[c]);
+			}
+		}
+	}
+}
+
+template<typename K>
+unsigned int CompactTrie<K>::height(const PatriciaTrie<K>& trie, const uint32_t index) const {
+	const typename PatriciaTrie<K>::patriciaNode& n = trie.data()[index];
+	unsigned int below = 0;
+
+	for(unsigned int c = 0; c < 2; ++c) {
+		if( n.children[c] != PatriciaTrie<K>::NONE ) {
+			const unsigned int h = this->height(trie, n.children[c]);
+			below = h > below ? h : below;
+		}
+	}
+
+	return below + 1;
+}
+
+/**
+ * Lays out the top height levels below index, upper half first and then
+ * each subtree hanging from it; roots just below those levels go to bottoms
+ */
+template<typename K>
+void CompactTrie<K>::layoutVeb(const PatriciaTrie<K>& trie, const uint32_t index, const unsigned int height, vector<uint32_t>& order, vector<uint32_t>& bottoms) const {
+	if( height == 1 ) {
+		const typename PatriciaTrie<K>::patriciaNode& n = trie.data()[index];
+
+		order.push_back(index);
+		for(unsigned int c = 0; c < 2; ++c) {
+			if( n.children[c] != PatriciaTrie<K>::NONE ) {
+				bottoms.push_back(n.children[c]);
+			}
+		}
+		return;
+	}
+
+	const unsigned int top = height / 2;
+	vector<uint32_t> middle;
+
+	this->layoutVeb(trie, index, top, order, middle);
+	for(unsigned int i = 0; i < middle.size(); ++i) {
+		this->layoutVeb(trie, middle[i], height - top, order, bottoms);
+	}
+}
+
+#endif	/* COMPACT_H */
@@ -0,0 +1,121 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "dir248.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+using std::exception;
+
+/**
+ * Orders prefixes so that longer ones overwrite shorter ones
+ */
+static bool shorterPrefix(const prefixEntry<uint32_t>& a, const prefixEntry<uint32_t>& b) {
+	return a.length < b.length;
+}
+
+
+Dir248::Dir248() {
+	this->tbl24 = NULL;
+}
+
+Dir248::~Dir248() {
+	huge_free(this->tbl24, TBL24_SIZE * sizeof(uint32_t));
+}
+
+void Dir248::clear() {
+	if( this->tbl24 == NULL ) {
+		this->tbl24 = (uint32_t*)huge_alloc(TBL24_SIZE * sizeof(uint32_t));
+		if( this->tbl24 == NULL ) {
+			throw std::bad_alloc();
+		}
+	}
+	memset(this->tbl24, 0, TBL24_SIZE * sizeof(uint32_t));
+
+	this->tblLong.clear();
+}
+
+void Dir248::build(const vector<prefixEntry<uint32_t> >& prefixes) {
+	vector<prefixEntry<uint32_t> > sorted(prefixes);
+	std::stable_sort(sorted.begin(), sorted.end(), shorterPrefix);
+
+	this->clear();
+
+	for(unsigned int i = 0; i < sorted.size(); ++i) {
+		const uint32_t key = key_mask(sorted[i].key, sorted[i].length);
+		const unsigned char length = sorted[i].length;
+		const uint32_t value = sorted[i].value;
+
+		if( value & LONG ) {
+			throw exception();
+		}
+
+		if( length <= 24 ) {
+			const uint32_t first = key >> 8;
+			const uint32_t last = first + (1u << (24 - length));
+			for(uint32_t e = first; e < last; ++e) {
+				this->tbl24[e] = value;
+			}
+			continue;
+		}
+
+		// longer than /24 - expand into overflow chunk
+		uint32_t& entry = this->tbl24[key >> 8];
+		if( (entry & LONG) == 0 ) {
+			const uint32_t chunk = this->tblLong.size() / CHUNK_SIZE;
+			if( chunk >= LONG ) {
+				throw exception();
+			}
+
+			this->tblLong.resize(this->tblLong.size() + CHUNK_SIZE, entry);
+			entry = chunk | LONG;
+		}
+
+		const uint32_t base = (entry & ~LONG) << 8;
+		const uint32_t first = key & 0xFF;
+		const uint32_t last = first + (1u << (32 - length));
+		for(uint32_t e = first; e < last; ++e) {
+			this->tblLong[base + e] = value;
+		}
+	}
+}
+
+void Dir248::findBatch(const uint32_t* keys, unsigned int* results, const unsigned int count) const {
+	uint32_t entries[BATCH_GROUP];
+
+	for(unsigned int group = 0; group < count; group += BATCH_GROUP) {
+		const unsigned int size = count - group < BATCH_GROUP ? count - group : BATCH_GROUP;
+		const uint32_t* key = keys + group;
+
+		for(unsigned int i = 0; i < size; ++i) {
+			PREFETCH(&this->tbl24[key[i] >> 8]);
+		}
+
+		for(unsigned int i = 0; i < size; ++i) {
+			entries[i] = this->tbl24[key[i] >> 8];
+			if( entries[i] & LONG ) {
+				entries[i] = ((entries[i] & ~LONG) << 8) | (key[i] & 0xFF);
+				PREFETCH(&this->tblLong[entries[i]]);
+				entries[i] |= LONG;
+			}
+		}
+
+		for(unsigned int i = 0; i < size; ++i) {
+			if( entries[i] & LONG ) {
+				entries[i] = this->tblLong[entries[i] & ~LONG];
+			}
+			results[group + i] = entries[i];
+		}
+	}
+}
+
+unsigned int Dir248::size() const {
+	return TBL24_SIZE * sizeof(uint32_t) + this->tblLong.size() * sizeof(uint32_t);
+}
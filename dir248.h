@@ -0,0 +1,73 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef DIR248_H
+#define	DIR248_H
+
+#include <vector>
+#include "engine.h"
+#include "hugepage.h"
+
+using std::vector;
+
+/**
+ * DIR-24-8 direct-indexed IPv4 table
+ *
+ * The first 24 bits of the address index a 2^24 entry table. Entries
+ * either hold the value (AsTable index) of the longest prefix covering
+ * that /24, or,
+ * when some prefix is longer than /24, point to a 256 entry overflow
+ * chunk indexed by the last octet. A lookup therefore costs one memory
+ * access, two in the worst case.
+ */
+class Dir248 : public LookupEngine<uint32_t> {
+
+	public:
+		static const uint32_t LONG = 0x80000000;
+		static const unsigned int TBL24_SIZE = 1 << 24;
+		static const unsigned int CHUNK_SIZE = 256;
+
+		Dir248();
+		virtual ~Dir248();
+
+		void build(const vector<prefixEntry<uint32_t> >& prefixes);
+		unsigned int find(const uint32_t& key) const;
+		void findBatch(const uint32_t* keys, unsigned int* results, const unsigned int count) const;
+		unsigned int trace(const uint32_t& key, unsigned int& depth) const;
+		void clear();
+
+		const char* name() const;
+		unsigned int size() const;
+
+	private:
+		uint32_t* tbl24;
+		vector<uint32_t, HugeAllocator<uint32_t> > tblLong;
+
+};
+
+inline unsigned int Dir248::find(const uint32_t& key) const {
+	uint32_t entry = this->tbl24[key >> 8];
+
+	if( entry & LONG ) {
+		entry = this->tblLong[((entry & ~LONG) << 8) | (key & 0xFF)];
+	}
+
+	return entry;
+}
+
+inline unsigned int Dir248::trace(const uint32_t& key, unsigned int& depth) const {
+	depth = this->tbl24[key >> 8] & LONG ? 32 : 24;
+	return depth == 32 ? 2 : 1;
+}
+
+inline const char* Dir248::name() const {
+	return "dir248";
+}
+
+#endif	/* DIR248_H */
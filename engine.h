@@ -0,0 +1,79 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef ENGINE_H
+#define	ENGINE_H
+
+#include <vector>
+#include "address.h"
+
+using std::vector;
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+/**
+ * Common contract of the integer lookup engines
+ *
+ * An engine is built once from a prefix set and then answers longest
+ * prefix queries, returning the value (AsTable index) of the best match
+ * or 0 when nothing matches. find() must be safe to call from several
+ * threads at once.
+ *
+ * generation() changes whenever the answers may have changed, so cached
+ * results can be dropped; engines built once stay at 0.
+ *
+ * trace() repeats a lookup for the debug statistics: it returns the
+ * number of nodes and entries read and sets depth to the bit position
+ * the walk ended at; engines that do not implement it return 0.
+ *
+ * findBatch() answers many queries at once; engines override it to walk
+ * a group of lookups in lock-step and prefetch the next node of each, so
+ * the cache misses of independent lookups overlap.
+ */
+template<typename K>
+class LookupEngine {
+
+	public:
+		virtual ~LookupEngine() {}
+
+		virtual void build(const vector<prefixEntry<K> >& prefixes) = 0;
+		virtual unsigned int find(const K& key) const = 0;
+		virtual void findBatch(const K* keys, unsigned int* results, const unsigned int count) const;
+		virtual uint64_t generation() const { return 0; }
+		virtual unsigned int trace(const K& key, unsigned int& depth) const;
+
+		virtual const char* name() const = 0;
+		virtual unsigned int size() const = 0;
+
+};
+
+
+/**
+ * Number of lookups kept in flight by the batch implementations
+ */
+const unsigned int BATCH_GROUP = 16;
+
+template<typename K>
+void LookupEngine<K>::findBatch(const K* keys, unsigned int* results, const unsigned int count) const {
+	for(unsigned int i = 0; i < count; ++i) {
+		results[i] = this->find(keys[i]);
+	}
+}
+
+template<typename K>
+unsigned int LookupEngine<K>::trace(const K&, unsigned int& depth) const {
+	depth = 0;
+	return 0;
+}
+
+#endif	/* ENGINE_H */
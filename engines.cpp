@@ -0,0 +1,67 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "engines.h"
+#include <stdlib.h>
+#include "patricia.h"
+#include "dir248.h"
+#include "poptrie.h"
+#include "live.h"
+#include "compact.h"
+#include "lctrie.h"
+
+/**
+ * Fill factor of "lctrie" or "lctrie:F" engine name
+ */
+double lctrie_fill(const string& name) {
+	const double fill = name.size() > 7 && name[6] == ':' ? atof(name.c_str() + 7) : 0.5;
+	return fill > 0 && fill <= 1 ? fill : 0.5;
+}
+
+/**
+ * Creates IPv4 lookup engine by name, NULL when unknown
+ */
+LookupEngine<uint32_t>* createEngine4(const string& name) {
+	if( name == "patricia" ) {
+		return new PatriciaTrie<uint32_t>();
+	} else if( name == "dir248" ) {
+		return new Dir248();
+	} else if( name == "live" ) {
+		return new LiveTable<uint32_t>();
+	} else if( name == "compact" ) {
+		return new CompactTrie<uint32_t>(CompactTrie<uint32_t>::ORDER_VEB);
+	} else if( name == "compact-bfs" ) {
+		return new CompactTrie<uint32_t>(CompactTrie<uint32_t>::ORDER_BFS);
+	} else if( name.compare(0, 6, "lctrie") == 0 ) {
+		return new LcTrie<uint32_t>(lctrie_fill(name));
+	}
+
+	return NULL;
+}
+
+/**
+ * Creates IPv6 lookup engine by name, NULL when unknown
+ */
+LookupEngine<uint128>* createEngine6(const string& name) {
+	if( name == "patricia" ) {
+		return new PatriciaTrie<uint128>();
+	} else if( name == "poptrie" ) {
+		return new Poptrie();
+	} else if( name == "live" ) {
+		return new LiveTable<uint128>();
+	} else if( name == "compact" ) {
+		return new CompactTrie<uint128>(CompactTrie<uint128>::ORDER_VEB);
+	} else if( name == "compact-bfs" ) {
+		return new CompactTrie<uint128>(CompactTrie<uint128>::ORDER_BFS);
+	} else if( name.compare(0, 6, "lctrie") == 0 ) {
+		return new LcTrie<uint128>(lctrie_fill(name));
+	}
+
+	return NULL;
+}
@@ -0,0 +1,48 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef ENGINES_H
+#define	ENGINES_H
+
+#include <string>
+#include "address.h"
+#include "engine.h"
+#include "patricia.h"
+#include "hugepage.h"
+
+using std::string;
+
+double lctrie_fill(const string& name);
+
+LookupEngine<uint32_t>* createEngine4(const string& name);
+LookupEngine<uint128>* createEngine6(const string& name);
+
+
+/**
+ * Builds selected engine from snapshot trie, the trie itself serves
+ * patricia and families the engine does not support; the mapped snapshot
+ * cannot be backed by huge pages, with a page policy it is copied
+ */
+template<typename K>
+LookupEngine<K>* resolveEngine(LookupEngine<K>* engine, PatriciaTrie<K>& trie) {
+	if( page_policy() != PAGES_DEFAULT && engine == NULL ) {
+		engine = new PatriciaTrie<K>();
+	} else if( page_policy() == PAGES_DEFAULT && (engine == NULL || dynamic_cast<PatriciaTrie<K>*>(engine) != NULL) ) {
+		delete engine;
+		return &trie;
+	}
+
+	vector<prefixEntry<K> > prefixes;
+	trie.prefixes(prefixes);
+	engine->build(prefixes);
+
+	return engine;
+}
+
+#endif	/* ENGINES_H */
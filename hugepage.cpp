@@ -0,0 +1,145 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "hugepage.h"
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif //WIN32
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+using std::map;
+
+static pagePolicy policy = PAGES_DEFAULT;
+
+/** Mapped blocks and their lengths, the rest came from malloc */
+static map<void*, size_t> mappings;
+static size_t mappedBytes = 0;
+static std::mutex mappingLock;
+
+
+static size_t round_up(const size_t size, const size_t unit) {
+	return (size + unit - 1) / unit * unit;
+}
+
+void set_page_policy(const pagePolicy value) {
+	policy = value;
+}
+
+pagePolicy page_policy() {
+	return policy;
+}
+
+bool parse_page_policy(const char* name, pagePolicy& value) {
+	if( strcmp(name, "thp") == 0 ) {
+		value = PAGES_THP;
+	} else if( strcmp(name, "2m") == 0 ) {
+		value = PAGES_2M;
+	} else if( strcmp(name, "1g") == 0 ) {
+		value = PAGES_1G;
+	} else if( strcmp(name, "none") == 0 ) {
+		value = PAGES_DEFAULT;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Allocates memory backed by huge pages according to the policy
+ * @return NULL when out of memory
+ */
+void* huge_alloc(const size_t size) {
+#ifdef _WIN32
+	return malloc(size);
+#else
+	const pagePolicy current = policy;
+	if( current == PAGES_DEFAULT || size < HUGE_THRESHOLD ) {
+		return malloc(size);
+	}
+
+	void* memory = MAP_FAILED;
+	size_t length = 0;
+
+	if( current == PAGES_2M || current == PAGES_1G ) {
+		const size_t unit = current == PAGES_1G ? (1 << 30) : (1 << 21);
+		length = round_up(size, unit);
+		memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (current == PAGES_1G ? MAP_HUGE_1GB : MAP_HUGE_2MB), -1, 0);
+	}
+
+	if( memory == MAP_FAILED ) {
+		// aligned to 2MB so that the whole block can be folded into huge pages
+		length = round_up(size, HUGE_THRESHOLD);
+		void* block = mmap(NULL, length + HUGE_THRESHOLD, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if( block == MAP_FAILED ) {
+			return NULL;
+		}
+
+		const size_t head = round_up((size_t)block, HUGE_THRESHOLD) - (size_t)block;
+		if( head > 0 ) {
+			munmap(block, head);
+		}
+		munmap((char*)block + head + length, HUGE_THRESHOLD - head);
+
+		memory = (char*)block + head;
+#ifdef MADV_HUGEPAGE
+		madvise(memory, length, MADV_HUGEPAGE);
+#endif
+	}
+
+	std::lock_guard<std::mutex> guard(mappingLock);
+	mappings[memory] = length;
+	mappedBytes += length;
+	return memory;
+#endif //WIN32
+}
+
+void huge_free(void* memory, const size_t size) {
+	if( memory == NULL ) {
+		return;
+	}
+
+#ifndef _WIN32
+	if( size >= HUGE_THRESHOLD ) {
+		std::unique_lock<std::mutex> guard(mappingLock);
+		map<void*, size_t>::iterator mapping = mappings.find(memory);
+		if( mapping != mappings.end() ) {
+			const size_t length = mapping->second;
+			mappedBytes -= length;
+			mappings.erase(mapping);
+			guard.unlock();
+
+			munmap(memory, length);
+			return;
+		}
+	}
+#endif //WIN32
+
+	free(memory);
+}
+
+/**
+ * Bytes currently held in mapped blocks
+ */
+size_t huge_mapped() {
+	std::lock_guard<std::mutex> guard(mappingLock);
+	return mappedBytes;
+}
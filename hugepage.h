@@ -0,0 +1,75 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef HUGEPAGE_H
+#define	HUGEPAGE_H
+
+#include <cstddef>
+#include <new>
+
+/**
+ * Backing of the large lookup tables
+ *
+ * PAGES_2M and PAGES_1G map reserved hugetlbfs pages (vm.nr_hugepages)
+ * and fall back to PAGES_THP when none are left, which asks for
+ * transparent huge pages with madvise. Allocations below HUGE_THRESHOLD
+ * always come from the heap, whatever the policy.
+ */
+enum pagePolicy { PAGES_DEFAULT, PAGES_THP, PAGES_2M, PAGES_1G };
+
+const size_t HUGE_THRESHOLD = 1 << 21;
+
+void set_page_policy(const pagePolicy policy);
+pagePolicy page_policy();
+bool parse_page_policy(const char* name, pagePolicy& policy);
+
+void* huge_alloc(const size_t size);
+void huge_free(void* memory, const size_t size);
+size_t huge_mapped();
+
+
+/**
+ * Standard allocator over huge_alloc, for the node arrays of the engines
+ */
+template<typename T>
+class HugeAllocator {
+
+	public:
+		typedef T value_type;
+
+		HugeAllocator() {}
+
+		template<typename U>
+		HugeAllocator(const HugeAllocator<U>&) {}
+
+		T* allocate(const size_t count) {
+			void* memory = huge_alloc(count * sizeof(T));
+			if( memory == NULL ) {
+				throw std::bad_alloc();
+			}
+			return (T*)memory;
+		}
+
+		void deallocate(T* memory, const size_t count) {
+			huge_free(memory, count * sizeof(T));
+		}
+
+};
+
+template<typename T, typename U>
+inline bool operator==(const HugeAllocator<T>&, const HugeAllocator<U>&) {
+	return true;
+}
+
+template<typename T, typename U>
+inline bool operator!=(const HugeAllocator<T>&, const HugeAllocator<U>&) {
+	return false;
+}
+
+#endif	/* HUGEPAGE_H */
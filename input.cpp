@@ -0,0 +1,167 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "input.h"
+#include <errno.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif //WIN32
+
+const size_t InputReader::BLOCK_SIZE;
+
+/**
+ * Position right after the last newline, 0 when there is none
+ */
+static size_t lineBoundary(const char* data, const size_t length) {
+#ifdef __GLIBC__
+	const char* last = (const char*)memrchr(data, '\n', length);
+	return last == NULL ? 0 : last - data + 1;
+#else
+	size_t end = length;
+	while( end > 0 && data[end - 1] != '\n' ) {
+		end--;
+	}
+	return end;
+#endif
+}
+
+
+InputReader::InputReader(FILE* file) {
+	this->file = file;
+	this->fd = -1;
+	this->mapping = NULL;
+	this->mappingSize = 0;
+	this->mappingPosition = 0;
+	this->eof = false;
+	this->lineBlock = NULL;
+	this->lineEnd = NULL;
+
+#ifndef _WIN32
+	this->fd = fileno(file);
+
+	// regular files are mapped whole
+	struct stat info;
+	if( fstat(this->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 ) {
+		const off_t offset = lseek(this->fd, 0, SEEK_CUR);
+		void* memory = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+
+		if( memory != MAP_FAILED && offset >= 0 && offset <= info.st_size ) {
+			madvise(memory, info.st_size, MADV_SEQUENTIAL);
+			this->mapping = (const char*)memory;
+			this->mappingSize = info.st_size;
+			this->mappingPosition = offset;
+		} else if( memory != MAP_FAILED ) {
+			munmap(memory, info.st_size);
+		}
+	}
+#endif //WIN32
+}
+
+InputReader::~InputReader() {
+#ifndef _WIN32
+	if( this->mapping != NULL ) {
+		munmap((void*)this->mapping, this->mappingSize);
+	}
+#endif //WIN32
+}
+
+/**
+ * Appends up to BLOCK_SIZE bytes of input to storage
+ */
+size_t InputReader::readMore(vector<char>& storage) {
+	const size_t filled = storage.size();
+	storage.resize(filled + BLOCK_SIZE);
+
+#ifdef _WIN32
+	size_t got = fread(&storage[filled], 1, BLOCK_SIZE, this->file);
+#else
+	ssize_t got;
+	do {
+		got = read(this->fd, &storage[filled], BLOCK_SIZE);
+	} while( got < 0 && errno == EINTR );
+
+	if( got < 0 ) {
+		got = 0;
+	}
+#endif //WIN32
+
+	storage.resize(filled + got);
+	return got;
+}
+
+/**
+ * Hands out next newline-aligned block
+ * @param storage buffer owned by caller, used only for non-mapped input;
+ *                the returned view stays valid while storage is untouched
+ *                (mapped input: until the reader is destroyed)
+ */
+bool InputReader::nextBlock(vector<char>& storage, const char*& data, size_t& length) {
+	if( this->mapping != NULL ) {
+		if( this->mappingPosition >= this->mappingSize ) {
+			return false;
+		}
+
+		const size_t remaining = this->mappingSize - this->mappingPosition;
+		length = remaining;
+
+		if( remaining > BLOCK_SIZE ) {
+			const char* newline = (const char*)memchr(this->mapping + this->mappingPosition + BLOCK_SIZE, '\n', remaining - BLOCK_SIZE);
+			if( newline != NULL ) {
+				length = newline - (this->mapping + this->mappingPosition) + 1;
+			}
+		}
+
+		data = this->mapping + this->mappingPosition;
+		this->mappingPosition += length;
+		return true;
+	}
+
+	storage.swap(this->carry);
+	this->carry.clear();
+
+	while( !this->eof ) {
+		const size_t before = storage.size();
+		if( this->readMore(storage) == 0 ) {
+			this->eof = true;
+			break;
+		}
+
+		const size_t boundary = lineBoundary(&storage[before], storage.size() - before);
+		if( boundary > 0 ) {
+			this->carry.assign(storage.begin() + before + boundary, storage.end());
+			storage.resize(before + boundary);
+			break;
+		}
+	}
+
+	if( storage.empty() ) {
+		return false;
+	}
+
+	data = &storage[0];
+	length = storage.size();
+	return true;
+}
+
+/**
+ * Hands out next line view, valid until the following call
+ */
+bool InputReader::nextLine(const char*& line, size_t& length) {
+	while( !next_line(this->lineBlock, this->lineEnd, line, length) ) {
+		size_t size;
+		if( !this->nextBlock(this->lineStorage, this->lineBlock, size) ) {
+			return false;
+		}
+		this->lineEnd = this->lineBlock + size;
+	}
+
+	return true;
+}
@@ -0,0 +1,80 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef INPUT_H
+#define	INPUT_H
+
+#include <stdio.h>
+#include <cstring>
+#include <vector>
+
+using std::vector;
+
+/**
+ * Bulk line input
+ *
+ * Regular files are mapped and handed out as views into the mapping
+ * without copying, pipes and terminals are read in large blocks. Input
+ * is always handed out in blocks ending at a line boundary, the last
+ * line may lack its newline.
+ */
+class InputReader {
+
+	public:
+		static const size_t BLOCK_SIZE = 1 << 20;
+
+		InputReader(FILE* file);
+		virtual ~InputReader();
+
+		bool nextBlock(vector<char>& storage, const char*& data, size_t& length);
+		bool nextLine(const char*& line, size_t& length);
+		bool isMapped() const;
+
+	private:
+		size_t readMore(vector<char>& storage);
+
+		int fd;
+		FILE* file;
+
+		const char* mapping;
+		size_t mappingSize;
+		size_t mappingPosition;
+
+		vector<char> carry;
+		bool eof;
+
+		// nextLine state
+		vector<char> lineStorage;
+		const char* lineBlock;
+		const char* lineEnd;
+
+};
+
+inline bool InputReader::isMapped() const {
+	return this->mapping != NULL;
+}
+
+/**
+ * Cuts next line off the view, newline excluded
+ * @return false when the view is exhausted
+ */
+inline bool next_line(const char*& position, const char* end, const char*& line, size_t& length) {
+	if( position >= end ) {
+		return false;
+	}
+
+	const char* newline = (const char*)memchr(position, '\n', end - position);
+	line = position;
+	length = (newline == NULL ? end : newline) - position;
+	position += length + 1;
+
+	return true;
+}
+
+#endif	/* INPUT_H */
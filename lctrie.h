@@ -0,0 +1,360 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef LCTRIE_H
+#define	LCTRIE_H
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "address.h"
+#include "engine.h"
+#include "patricia.h"
+
+using std::vector;
+
+/**
+ * Level-compressed trie (Nilsson, Karlsson)
+ *
+ * Prefixes that are not a prefix of any other one form the base vector,
+ * the rest the prefix vector; every entry links to its longest proper
+ * prefix. The trie is built over the base vector only: besides path
+ * compression (skip), a node with branch k consumes k bits at once and
+ * has 2^k consecutive children. k grows while at least fillFactor of the
+ * 2^k children would be non-empty.
+ *
+ * Skipped bits are not compared on the way down, the leaf reached is then
+ * checked against the key and, when it does not match, its prefix chain
+ * is followed. Empty children get an entry of their own covering their
+ * whole range, holding the precomputed answer for it.
+ */
+template<typename K>
+class LcTrie : public LookupEngine<K> {
+
+	public:
+		static const uint32_t NONE = 0xFFFFFFFF;
+		static const unsigned int MAX_BRANCH = 20;
+
+		typedef struct lcNode {
+			uint32_t adr;
+			unsigned char branch;
+			unsigned char skip;
+		} lcNode;
+
+		typedef struct lcEntry {
+			K key;
+			unsigned int value;
+			uint32_t pre;
+			unsigned char length;
+		} lcEntry;
+
+		LcTrie(const double fillFactor);
+
+		void build(const vector<prefixEntry<K> >& prefixes);
+		unsigned int find(const K& key) const;
+		unsigned int trace(const K& key, unsigned int& depth) const;
+
+		const char* name() const;
+		unsigned int size() const;
+		double averageDepth() const;
+
+	private:
+		void buildNode(const uint32_t index, const uint32_t first, const uint32_t count, const unsigned int pos);
+		unsigned int computeBranch(const uint32_t first, const uint32_t count, const unsigned int pos) const;
+		uint32_t rangeEntry(const K& key, const unsigned char length);
+
+		double fillFactor;
+		vector<lcNode, HugeAllocator<lcNode> > nodes;
+		vector<lcEntry, HugeAllocator<lcEntry> > base;
+		vector<lcEntry, HugeAllocator<lcEntry> > prefix;
+
+		// build time only, values and prefix vector positions (+1)
+		PatriciaTrie<K> answers;
+		PatriciaTrie<K> chains;
+
+};
+
+
+template<typename K>
+LcTrie<K>::LcTrie(const double fillFactor) {
+	this->fillFactor = fillFactor;
+}
+
+template<typename K>
+inline const char* LcTrie<K>::name() const {
+	return "lctrie";
+}
+
+template<typename K>
+inline unsigned int LcTrie<K>::size() const {
+	return this->nodes.size() * sizeof(lcNode) + (this->base.size() + this->prefix.size()) * sizeof(lcEntry);
+}
+
+template<typename K>
+unsigned int LcTrie<K>::find(const K& key) const {
+	const lcNode* nodes = &this->nodes[0];
+	unsigned int pos = nodes[0].skip;
+	unsigned int branch = nodes[0].branch;
+	uint32_t adr = nodes[0].adr;
+
+	while( branch != 0 ) {
+		const lcNode& n = nodes[adr + key_extract(key, pos, branch)];
+		pos += branch + n.skip;
+		branch = n.branch;
+		adr = n.adr;
+	}
+
+	const lcEntry* entry = &this->base[adr];
+	if( key_common(key, entry->key) >= entry->length ) {
+		return entry->value;
+	}
+
+	for(uint32_t p = entry->pre; p != NONE; p = this->prefix[p].pre) {
+		if( key_common(key, this->prefix[p].key) >= this->prefix[p].length ) {
+			return this->prefix[p].value;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Nodes on the way down, then the base entry and the prefix chain entries
+ * compared; depth is the bit position the leaf was reached at
+ */
+template<typename K>
+unsigned int LcTrie<K>::trace(const K& key, unsigned int& depth) const {
+	unsigned int pos = this->nodes[0].skip;
+	unsigned int branch = this->nodes[0].branch;
+	uint32_t adr = this->nodes[0].adr;
+	unsigned int visited = 1;
+
+	while( branch != 0 ) {
+		const lcNode& n = this->nodes[adr + key_extract(key, pos, branch)];
+		pos += branch + n.skip;
+		branch = n.branch;
+		adr = n.adr;
+		visited++;
+	}
+
+	depth = pos;
+	const lcEntry* entry = &this->base[adr];
+	visited++;
+	if( key_common(key, entry->key) >= entry->length ) {
+		return visited;
+	}
+
+	for(uint32_t p = entry->pre; p != NONE; p = this->prefix[p].pre) {
+		visited++;
+		if( key_common(key, this->prefix[p].key) >= this->prefix[p].length ) {
+			break;
+		}
+	}
+
+	return visited;
+}
+
+/**
+ * Mean number of nodes visited per base entry, for comparing fill factors
+ */
+template<typename K>
+double LcTrie<K>::averageDepth() const {
+	unsigned long long total = 0;
+	unsigned long long leaves = 0;
+	vector<std::pair<uint32_t, unsigned int> > stack(1, std::make_pair(0u, 1u));
+
+	while( !stack.empty() ) {
+		const std::pair<uint32_t, unsigned int> top = stack.back();
+		stack.pop_back();
+
+		const lcNode& n = this->nodes[top.first];
+		if( n.branch == 0 ) {
+			total += top.second;
+			leaves++;
+			continue;
+		}
+
+		for(uint32_t i = 0; i < (1u << n.branch); ++i) {
+			stack.push_back(std::make_pair(n.adr + i, top.second + 1));
+		}
+	}
+
+	return leaves == 0 ? 0 : (double)total / leaves;
+}
+
+
+template<typename K>
+void LcTrie<K>::build(const vector<prefixEntry<K> >& prefixes) {
+	vector<prefixEntry<K> > sorted;
+	sorted.reserve(prefixes.size());
+
+	for(unsigned int i = 0; i < prefixes.size(); ++i) {
+		if( prefixes[i].value != 0 ) {
+			sorted.push_back(prefixes[i]);
+			sorted.back().key = key_mask(prefixes[i].key, prefixes[i].length);
+		}
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), prefix_order<K>);
+
+	// of equal prefixes the last one wins
+	unsigned int unique = 0;
+	for(unsigned int i = 0; i < sorted.size(); ++i) {
+		if( unique > 0 && sorted[unique - 1].key == sorted[i].key && sorted[unique - 1].length == sorted[i].length ) {
+			sorted[unique - 1] = sorted[i];
+		} else {
+			sorted[unique++] = sorted[i];
+		}
+	}
+	sorted.resize(unique);
+
+	this->nodes.clear();
+	this->base.clear();
+	this->prefix.clear();
+	this->answers.buildSorted(sorted);
+	this->chains.clear();
+
+	// split into base and prefix vector, descendants follow right after their prefix
+	vector<uint32_t> path;
+	for(unsigned int i = 0; i < sorted.size(); ++i) {
+		lcEntry entry;
+		entry.key = sorted[i].key;
+		entry.length = sorted[i].length;
+		entry.value = sorted[i].value;
+
+		while( !path.empty() ) {
+			const lcEntry& top = this->prefix[path.back()];
+			if( top.length < entry.length && key_common(top.key, entry.key) >= top.length ) {
+				break;
+			}
+			path.pop_back();
+		}
+		entry.pre = path.empty() ? NONE : path.back();
+
+		const bool internal = i + 1 < sorted.size() && sorted[i + 1].length > entry.length
+			&& key_common(sorted[i + 1].key, entry.key) >= entry.length;
+
+		if( internal ) {
+			path.push_back(this->prefix.size());
+			this->prefix.push_back(entry);
+			this->chains.insert(entry.key, entry.length, this->prefix.size());
+		} else {
+			this->base.push_back(entry);
+		}
+	}
+
+	const uint32_t count = this->base.size();
+	this->nodes.resize(1);
+
+	if( count == 0 ) {
+		this->nodes[0].adr = this->rangeEntry(K(), 0);
+		this->nodes[0].branch = 0;
+		this->nodes[0].skip = 0;
+	} else {
+		this->buildNode(0, 0, count, 0);
+	}
+
+	this->answers.clear();
+	this->chains.clear();
+}
+
+/**
+ * Base vector entry for a range without base entries: it holds the best
+ * answer inside the range, the prefix chain serves keys that reach it
+ * despite differing in skipped bits
+ */
+template<typename K>
+uint32_t LcTrie<K>::rangeEntry(const K& key, const unsigned char length) {
+	lcEntry entry;
+	entry.key = key;
+	entry.length = length;
+	entry.value = this->answers.find(key);
+	entry.pre = this->chains.find(key) - 1;
+
+	this->base.push_back(entry);
+	return this->base.size() - 1;
+}
+
+/**
+ * Largest branch with enough non-empty children, always at least 1
+ */
+template<typename K>
+unsigned int LcTrie<K>::computeBranch(const uint32_t first, const uint32_t count, const unsigned int pos) const {
+	const unsigned int width = key_width(K());
+	unsigned int branch = 1;
+
+	while( branch < MAX_BRANCH && pos + branch < width && (1u << (branch + 1)) <= count / this->fillFactor + 1 ) {
+		const unsigned int next = branch + 1;
+		unsigned int patterns = 0;
+		uint32_t previous = 0;
+
+		for(uint32_t i = first; i < first + count; ++i) {
+			const uint32_t pattern = key_extract(this->base[i].key, pos, next);
+			if( i == first || pattern != previous ) {
+				patterns++;
+				previous = pattern;
+			}
+		}
+
+		if( patterns < this->fillFactor * (1u << next) ) {
+			break;
+		}
+		branch = next;
+	}
+
+	return branch;
+}
+
+/**
+ * Builds node over base entries first..first+count (at least two),
+ * their first pos bits are equal
+ */
+template<typename K>
+void LcTrie<K>::buildNode(const uint32_t index, const uint32_t first, const uint32_t count, const unsigned int pos) {
+	if( count == 1 ) {
+		this->nodes[index].adr = first;
+		this->nodes[index].branch = 0;
+		this->nodes[index].skip = 0;
+		return;
+	}
+
+	const uint32_t last = first + count - 1;
+	const unsigned int common = key_common(this->base[first].key, this->base[last].key);
+	const unsigned int at = common;
+	const unsigned int skip = at - pos;
+	const unsigned int branch = this->computeBranch(first, count, at);
+	const uint32_t adr = this->nodes.size();
+
+	this->nodes[index].adr = adr;
+	this->nodes[index].branch = branch;
+	this->nodes[index].skip = skip;
+	this->nodes.resize(adr + (1u << branch));
+
+	const K stem = key_mask(this->base[first].key, at);
+	uint32_t start = first;
+
+	for(uint32_t pattern = 0; pattern < (1u << branch); ++pattern) {
+		uint32_t end = start;
+		while( end <= last && key_extract(this->base[end].key, at, branch) == pattern ) {
+			end++;
+		}
+
+		if( end == start ) {
+			this->nodes[adr + pattern].adr = this->rangeEntry(key_deposit(stem, at, branch, pattern), at + branch);
+			this->nodes[adr + pattern].branch = 0;
+			this->nodes[adr + pattern].skip = 0;
+		} else {
+			this->buildNode(adr + pattern, start, end - start, at + branch);
+		}
+
+		start = end;
+	}
+}
+
+#endif	/* LCTRIE_H */
@@ -0,0 +1,510 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef LIVE_H
+#define	LIVE_H
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <stdint.h>
+#include "address.h"
+#include "engine.h"
+#include "patricia.h"
+#include "astable.h"
+
+using std::vector;
+
+/**
+ * Small per-thread number spreading readers over the epoch slots
+ */
+inline unsigned int live_reader_hint() {
+	static std::atomic<unsigned int> next(0);
+	static thread_local unsigned int hint = next.fetch_add(1);
+	return hint;
+}
+
+/**
+ * Path-compressed binary trie taking route updates while being queried
+ *
+ * Nodes are never modified once published. An update copies the path from
+ * the root down to the changed node and swaps the root pointer, so readers
+ * always walk a consistent version and never wait for writers. Writers are
+ * serialized by a mutex.
+ *
+ * Replaced nodes are reclaimed by epochs: a lookup occupies a reader slot
+ * tagged with the global epoch for its duration, and a node retired in
+ * epoch e is freed once no slot holds e or anything older.
+ */
+template<typename K>
+class LiveTable : public LookupEngine<K> {
+
+	public:
+		static const unsigned int MAX_READERS = 64;
+
+		typedef struct liveNode {
+			K prefix;
+			const struct liveNode* children[2];
+			unsigned int value;
+			unsigned char length;
+		} liveNode;
+
+		LiveTable();
+		virtual ~LiveTable();
+
+		void build(const vector<prefixEntry<K> >& prefixes);
+		bool announce(const K& key, const unsigned char length, const unsigned int as, AsTable& table);
+		bool withdraw(const K& key, const unsigned char length);
+
+		unsigned int find(const K& key) const;
+		void findBatch(const K* keys, unsigned int* results, const unsigned int count) const;
+		unsigned int trace(const K& key, unsigned int& depth) const;
+		uint64_t generation() const;
+
+		const char* name() const;
+		unsigned int count() const;
+		unsigned int size() const;
+		unsigned int pending() const;
+
+	private:
+		static const uint64_t IDLE = 0;
+
+		typedef struct readerSlot {
+			std::atomic<uint64_t> epoch;
+			char padding[64 - sizeof(std::atomic<uint64_t>)];
+		} readerSlot;
+
+		typedef struct retiredNode {
+			const liveNode* node;
+			uint64_t epoch;
+		} retiredNode;
+
+		LiveTable(const LiveTable&);
+		LiveTable& operator=(const LiveTable&);
+
+		unsigned int enter() const;
+		void leave(const unsigned int slot) const;
+		unsigned int lookup(const liveNode* root, const K& key) const;
+
+		liveNode* createNode(const K& key, const unsigned char length, const unsigned int value);
+		liveNode* copyNode(const liveNode* n);
+		const liveNode* convert(const PatriciaTrie<K>& trie, const unsigned int index);
+		const liveNode* insert(const liveNode* n, const K& key, const unsigned char length, const unsigned int value, bool& added);
+		const liveNode* remove(const liveNode* n, const K& key, const unsigned char length, bool& removed);
+
+		void retire(const liveNode* n);
+		void retireTree(const liveNode* n);
+		void publish(const liveNode* root);
+		void reclaim();
+
+		std::atomic<const liveNode*> root;
+		std::atomic<uint64_t> epoch;
+		mutable readerSlot readers[MAX_READERS];
+
+		std::mutex writer;
+		vector<retiredNode> retired;
+		unsigned int _size;
+		unsigned int _nodes;
+
+};
+
+
+template<typename K>
+LiveTable<K>::LiveTable() {
+	for(unsigned int i = 0; i < MAX_READERS; ++i) {
+		this->readers[i].epoch.store(IDLE);
+	}
+
+	this->epoch.store(1);
+	this->_size = 0;
+	this->_nodes = 0;
+	this->root.store(this->createNode(K(), 0, 0));
+}
+
+/**
+ * No reader may be active anymore
+ */
+template<typename K>
+LiveTable<K>::~LiveTable() {
+	this->retireTree(this->root.load());
+	for(unsigned int i = 0; i < this->retired.size(); ++i) {
+		delete this->retired[i].node;
+	}
+}
+
+template<typename K>
+inline const char* LiveTable<K>::name() const {
+	return "live";
+}
+
+template<typename K>
+inline unsigned int LiveTable<K>::count() const {
+	return this->_size;
+}
+
+template<typename K>
+inline unsigned int LiveTable<K>::size() const {
+	return this->_nodes * sizeof(liveNode);
+}
+
+/**
+ * Epoch grows with every published version
+ */
+template<typename K>
+inline uint64_t LiveTable<K>::generation() const {
+	return this->epoch.load();
+}
+
+/**
+ * Number of replaced nodes waiting for readers to move on
+ */
+template<typename K>
+inline unsigned int LiveTable<K>::pending() const {
+	return this->retired.size();
+}
+
+
+/**
+ * Occupies a reader slot with the current epoch, returns the slot
+ */
+template<typename K>
+unsigned int LiveTable<K>::enter() const {
+	unsigned int slot = live_reader_hint() % MAX_READERS;
+
+	while( true ) {
+		for(unsigned int i = 0; i < MAX_READERS; ++i, slot = (slot + 1) % MAX_READERS) {
+			uint64_t idle = IDLE;
+			if( this->readers[slot].epoch.load(std::memory_order_relaxed) == IDLE
+				&& this->readers[slot].epoch.compare_exchange_strong(idle, this->epoch.load()) ) {
+				return slot;
+			}
+		}
+
+		// more concurrent readers than slots
+		std::this_thread::yield();
+	}
+}
+
+template<typename K>
+inline void LiveTable<K>::leave(const unsigned int slot) const {
+	this->readers[slot].epoch.store(IDLE, std::memory_order_release);
+}
+
+template<typename K>
+inline unsigned int LiveTable<K>::lookup(const liveNode* n, const K& key) const {
+	const unsigned int width = key_width(key);
+	unsigned int best = 0;
+
+	while( n != NULL ) {
+		if( key_clz(key_xor(key, n->prefix)) < n->length ) {
+			break;
+		}
+
+		if( n->value != 0 ) {
+			best = n->value;
+		}
+
+		if( n->length == width ) {
+			break;
+		}
+
+		n = n->children[key_bit(key, n->length)];
+	}
+
+	return best;
+}
+
+template<typename K>
+unsigned int LiveTable<K>::find(const K& key) const {
+	const unsigned int slot = this->enter();
+	const unsigned int best = this->lookup(this->root.load(), key);
+	this->leave(slot);
+
+	return best;
+}
+
+template<typename K>
+unsigned int LiveTable<K>::trace(const K& key, unsigned int& depth) const {
+	const unsigned int width = key_width(key);
+	const unsigned int slot = this->enter();
+	const liveNode* n = this->root.load();
+	unsigned int visited = 0;
+
+	depth = 0;
+	while( n != NULL ) {
+		visited++;
+
+		if( key_clz(key_xor(key, n->prefix)) < n->length ) {
+			break;
+		}
+
+		depth = n->length;
+		if( n->length == width ) {
+			break;
+		}
+
+		n = n->children[key_bit(key, n->length)];
+	}
+
+	this->leave(slot);
+	return visited;
+}
+
+/**
+ * Whole batch is answered from one version of the table
+ */
+template<typename K>
+void LiveTable<K>::findBatch(const K* keys, unsigned int* results, const unsigned int count) const {
+	const unsigned int slot = this->enter();
+	const liveNode* root = this->root.load();
+
+	for(unsigned int i = 0; i < count; ++i) {
+		results[i] = this->lookup(root, keys[i]);
+	}
+
+	this->leave(slot);
+}
+
+
+template<typename K>
+typename LiveTable<K>::liveNode* LiveTable<K>::createNode(const K& key, const unsigned char length, const unsigned int value) {
+	liveNode* n = new liveNode;
+	n->prefix = key_mask(key, length);
+	n->children[0] = NULL;
+	n->children[1] = NULL;
+	n->value = value;
+	n->length = length;
+
+	this->_nodes++;
+	return n;
+}
+
+template<typename K>
+typename LiveTable<K>::liveNode* LiveTable<K>::copyNode(const liveNode* n) {
+	liveNode* copy = new liveNode(*n);
+	this->_nodes++;
+	return copy;
+}
+
+template<typename K>
+void LiveTable<K>::retire(const liveNode* n) {
+	retiredNode r;
+	r.node = n;
+	r.epoch = this->epoch.load(std::memory_order_relaxed);
+	this->retired.push_back(r);
+	this->_nodes--;
+}
+
+template<typename K>
+void LiveTable<K>::retireTree(const liveNode* n) {
+	if( n == NULL ) {
+		return;
+	}
+
+	this->retireTree(n->children[0]);
+	this->retireTree(n->children[1]);
+	this->retire(n);
+}
+
+/**
+ * Makes new version visible, then frees what no reader can see anymore
+ */
+template<typename K>
+void LiveTable<K>::publish(const liveNode* root) {
+	this->root.store(root);
+	this->epoch.fetch_add(1);
+	this->reclaim();
+}
+
+template<typename K>
+void LiveTable<K>::reclaim() {
+	uint64_t oldest = this->epoch.load();
+	for(unsigned int i = 0; i < MAX_READERS; ++i) {
+		const uint64_t e = this->readers[i].epoch.load();
+		if( e != IDLE && e < oldest ) {
+			oldest = e;
+		}
+	}
+
+	// retired in epoch order
+	unsigned int freed = 0;
+	while( freed < this->retired.size() && this->retired[freed].epoch < oldest ) {
+		delete this->retired[freed++].node;
+	}
+	this->retired.erase(this->retired.begin(), this->retired.begin() + freed);
+}
+
+
+/**
+ * Replaces the whole content, built through the static trie and copied over
+ */
+template<typename K>
+void LiveTable<K>::build(const vector<prefixEntry<K> >& prefixes) {
+	PatriciaTrie<K> trie;
+	trie.build(prefixes);
+
+	std::lock_guard<std::mutex> guard(this->writer);
+
+	const liveNode* previous = this->root.load();
+	const liveNode* root = this->convert(trie, 0);
+	this->_size = trie.count();
+
+	this->retireTree(previous);
+	this->publish(root);
+}
+
+template<typename K>
+const typename LiveTable<K>::liveNode* LiveTable<K>::convert(const PatriciaTrie<K>& trie, const unsigned int index) {
+	const typename PatriciaTrie<K>::patriciaNode& source = trie.data()[index];
+	liveNode* n = this->createNode(source.prefix, source.length, source.value);
+
+	for(unsigned int i = 0; i < 2; ++i) {
+		if( source.children[i] != PatriciaTrie<K>::NONE ) {
+			n->children[i] = this->convert(trie, source.children[i]);
+		}
+	}
+
+	return n;
+}
+
+/**
+ * Adds or replaces prefix, returns true when it was not present before
+ * @param table AS table the values index, the AS is interned into it
+ * before the path referring to it is published; all updates of tables
+ * sharing it must go through this writer
+ */
+template<typename K>
+bool LiveTable<K>::announce(const K& key, const unsigned char length, const unsigned int as, AsTable& table) {
+	if( as == 0 || length > key_width(key) ) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(this->writer);
+
+	const unsigned int value = table.intern(as);
+	bool added = false;
+	this->publish(this->insert(this->root.load(), key_mask(key, length), length, value, added));
+	if( added ) {
+		this->_size++;
+	}
+
+	return added;
+}
+
+/**
+ * Removes prefix, returns false when it was not present
+ */
+template<typename K>
+bool LiveTable<K>::withdraw(const K& key, const unsigned char length) {
+	if( length > key_width(key) ) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(this->writer);
+
+	bool removed = false;
+	const liveNode* root = this->remove(this->root.load(), key_mask(key, length), length, removed);
+	if( removed ) {
+		this->publish(root);
+		this->_size--;
+	}
+
+	return removed;
+}
+
+/**
+ * Returns copy of subtree n (a prefix of key) with the prefix set
+ */
+template<typename K>
+const typename LiveTable<K>::liveNode* LiveTable<K>::insert(const liveNode* n, const K& key, const unsigned char length, const unsigned int value, bool& added) {
+	liveNode* copy = this->copyNode(n);
+	this->retire(n);
+
+	if( n->length == length ) {
+		added = n->value == 0;
+		copy->value = value;
+		return copy;
+	}
+
+	const unsigned int bit = key_bit(key, n->length);
+	const liveNode* child = n->children[bit];
+	added = true;
+
+	// free slot - insert value leaf
+	if( child == NULL ) {
+		copy->children[bit] = this->createNode(key, length, value);
+		return copy;
+	}
+
+	unsigned int common = key_common(key, child->prefix);
+	if( common > length ) {
+		common = length;
+	}
+
+	// child is a prefix of key - descend
+	if( common >= child->length ) {
+		copy->children[bit] = this->insert(child, key, length, value, added);
+		return copy;
+	}
+
+	// split the edge between n and child, child itself is shared
+	liveNode* split = this->createNode(key, common, common == length ? value : 0);
+	split->children[key_bit(child->prefix, common)] = child;
+	if( common < length ) {
+		split->children[key_bit(key, common)] = this->createNode(key, length, value);
+	}
+
+	copy->children[bit] = split;
+	return copy;
+}
+
+/**
+ * Returns subtree n without the prefix, nodes left without value and
+ * with a single child are merged into it so the trie stays compressed
+ */
+template<typename K>
+const typename LiveTable<K>::liveNode* LiveTable<K>::remove(const liveNode* n, const K& key, const unsigned char length, bool& removed) {
+	const liveNode* replacement[2] = {n->children[0], n->children[1]};
+
+	if( n->length == length ) {
+		if( n->value == 0 ) {
+			return n;
+		}
+	} else {
+		const unsigned int bit = key_bit(key, n->length);
+		const liveNode* child = n->children[bit];
+
+		if( child == NULL || child->length > length || key_common(key, child->prefix) < child->length ) {
+			return n;
+		}
+
+		replacement[bit] = this->remove(child, key, length, removed);
+		if( !removed ) {
+			return n;
+		}
+	}
+
+	removed = true;
+	const unsigned int value = n->length == length ? 0 : n->value;
+	this->retire(n);
+
+	// root always stays
+	if( n->length == 0 || value != 0 || (replacement[0] != NULL && replacement[1] != NULL) ) {
+		liveNode* copy = this->copyNode(n);
+		copy->value = value;
+		copy->children[0] = replacement[0];
+		copy->children[1] = replacement[1];
+		return copy;
+	}
+
+	return replacement[0] != NULL ? replacement[0] : replacement[1];
+}
+
+#endif	/* LIVE_H */
@@ -0,0 +1,272 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "lpm.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include "patricia.h"
+#include "engines.h"
+#include "astable.h"
+#include "snapshot.h"
+#include "shared.h"
+#include "mapping.h"
+#include "live.h"
+
+using std::string;
+using std::vector;
+
+/** Keys converted per findBatch call of the batch entry points */
+static const unsigned int LOOKUP_CHUNK = 256;
+
+struct lpm_table {
+	PatriciaTrie<uint32_t> trie;
+	PatriciaTrie<uint128> trie6;
+	AsTable table;
+	AsTable table6;
+	Snapshot snapshot4;
+	Snapshot snapshot6;
+	SharedTable shared;
+	LookupEngine<uint32_t>* engine;
+	LookupEngine<uint128>* engine6;
+	string sharedName;
+	string engineName;
+};
+
+
+static uint128 key_from_bytes(const uint8_t address[16]) {
+	uint128 key;
+	key.high = 0;
+	key.low = 0;
+	for(unsigned int i = 0; i < 8; ++i) {
+		key.high = (key.high << 8) | address[i];
+		key.low = (key.low << 8) | address[i + 8];
+	}
+	return key;
+}
+
+/**
+ * Creates an empty table with the engines of the given name
+ * @return NULL for an unknown engine
+ */
+static lpm_table* create_table(const char* engine) {
+	const string name(engine != NULL ? engine : "patricia");
+
+	lpm_table* table = new lpm_table;
+	table->engine = NULL;
+	table->engine6 = NULL;
+	try {
+		table->engine = createEngine4(name);
+		table->engine6 = createEngine6(name);
+	} catch(...) {
+		lpm_close(table);
+		throw;
+	}
+
+	if( table->engine == NULL && table->engine6 == NULL ) {
+		delete table;
+		return NULL;
+	}
+	return table;
+}
+
+/**
+ * Builds the engines once the tries are loaded, or releases the table
+ */
+static lpm_table* finish_table(lpm_table* table, const bool loaded) {
+	if( !loaded ) {
+		delete table->engine;
+		delete table->engine6;
+		delete table;
+		return NULL;
+	}
+
+	table->engine = resolveEngine(table->engine, table->trie);
+	table->engine6 = resolveEngine(table->engine6, table->trie6);
+	return table;
+}
+
+
+lpm_table* lpm_open_mapping(const char* path, const char* engine) {
+	lpm_table* table = NULL;
+	try {
+		table = create_table(engine);
+		if( table == NULL ) {
+			return NULL;
+		}
+
+		vector<prefixEntry<uint32_t> > prefixes;
+		vector<prefixEntry<uint128> > prefixes6;
+		const unsigned int threads = std::thread::hardware_concurrency();
+		const bool loaded = loadMappingFile(path, prefixes, prefixes6, table->table, table->table6, threads > 0 ? threads : 1);
+		if( loaded ) {
+			build_tries(table->trie, prefixes, table->trie6, prefixes6, threads > 0 ? threads : 1);
+		}
+
+		return finish_table(table, loaded);
+	} catch(...) {
+		lpm_close(table);
+		return NULL;
+	}
+}
+
+lpm_table* lpm_open_snapshot(const char* path, const char* engine, int verify) {
+	lpm_table* table = NULL;
+	try {
+		table = create_table(engine);
+		if( table == NULL ) {
+			return NULL;
+		}
+
+		const string base(path);
+		const bool loaded = snapshot_load(table->snapshot4, base + ".tree4", table->trie, table->table, verify != 0)
+			&& snapshot_load(table->snapshot6, base + ".tree6", table->trie6, table->table6, verify != 0);
+
+		return finish_table(table, loaded);
+	} catch(...) {
+		lpm_close(table);
+		return NULL;
+	}
+}
+
+lpm_table* lpm_open_shared(const char* name, const char* engine, int verify) {
+	lpm_table* table = NULL;
+	try {
+		table = create_table(engine);
+		if( table == NULL ) {
+			return NULL;
+		}
+
+		table->sharedName = name;
+		table->engineName = engine != NULL ? engine : "";
+		const bool loaded = table->shared.attach(name, table->trie, table->table, table->trie6, table->table6, verify != 0);
+
+		return finish_table(table, loaded);
+	} catch(...) {
+		lpm_close(table);
+		return NULL;
+	}
+}
+
+lpm_table* lpm_reopen(const lpm_table* table, int verify) {
+	if( table->sharedName.empty() ) {
+		return NULL;
+	}
+	return lpm_open_shared(table->sharedName.c_str(), table->engineName.empty() ? NULL : table->engineName.c_str(), verify);
+}
+
+uint64_t lpm_generation(const lpm_table* table) {
+	return table->shared.generation();
+}
+
+int lpm_stale(const lpm_table* table) {
+	return table->shared.stale() ? 1 : 0;
+}
+
+void lpm_close(lpm_table* table) {
+	if( table == NULL ) {
+		return;
+	}
+
+	if( table->engine != &table->trie ) {
+		delete table->engine;
+	}
+	if( table->engine6 != &table->trie6 ) {
+		delete table->engine6;
+	}
+	delete table;
+}
+
+uint32_t lpm_lookup_v4(const lpm_table* table, uint32_t address) {
+	return table->table.as(table->engine->find(address));
+}
+
+uint32_t lpm_lookup_v6(const lpm_table* table, const uint8_t address[16]) {
+	return table->table6.as(table->engine6->find(key_from_bytes(address)));
+}
+
+void lpm_lookup_v4_batch(const lpm_table* table, const uint32_t* addresses, uint32_t* as, size_t count) {
+	unsigned int located[LOOKUP_CHUNK];
+
+	while( count > 0 ) {
+		const unsigned int chunk = count < LOOKUP_CHUNK ? count : LOOKUP_CHUNK;
+		table->engine->findBatch(addresses, located, chunk);
+		for(unsigned int i = 0; i < chunk; ++i) {
+			as[i] = table->table.as(located[i]);
+		}
+
+		addresses += chunk;
+		as += chunk;
+		count -= chunk;
+	}
+}
+
+void lpm_lookup_v6_batch(const lpm_table* table, const uint8_t (*addresses)[16], uint32_t* as, size_t count) {
+	uint128 keys[LOOKUP_CHUNK];
+	unsigned int located[LOOKUP_CHUNK];
+
+	while( count > 0 ) {
+		const unsigned int chunk = count < LOOKUP_CHUNK ? count : LOOKUP_CHUNK;
+		for(unsigned int i = 0; i < chunk; ++i) {
+			keys[i] = key_from_bytes(addresses[i]);
+		}
+		table->engine6->findBatch(keys, located, chunk);
+		for(unsigned int i = 0; i < chunk; ++i) {
+			as[i] = table->table6.as(located[i]);
+		}
+
+		addresses += chunk;
+		as += chunk;
+		count -= chunk;
+	}
+}
+
+/**
+ * Announces, or withdraws for AS 0, a prefix of a live table
+ */
+template<typename K>
+static int update_live(LookupEngine<K>* engine, AsTable& table, const K& key, const unsigned int length, const uint32_t as) {
+	LiveTable<K>* live = dynamic_cast<LiveTable<K>*>(engine);
+	if( live == NULL || length > key_width(key) ) {
+		return -1;
+	}
+
+	try {
+		return (as != 0 ? live->announce(key, length, as, table) : live->withdraw(key, length)) ? 1 : 0;
+	} catch(...) {
+		// out of memory
+		return -1;
+	}
+}
+
+int lpm_announce_v4(lpm_table* table, uint32_t address, unsigned int length, uint32_t as) {
+	return as == 0 ? -1 : update_live(table->engine, table->table, address, length, as);
+}
+
+int lpm_announce_v6(lpm_table* table, const uint8_t address[16], unsigned int length, uint32_t as) {
+	return as == 0 ? -1 : update_live(table->engine6, table->table6, key_from_bytes(address), length, as);
+}
+
+int lpm_withdraw_v4(lpm_table* table, uint32_t address, unsigned int length) {
+	return update_live(table->engine, table->table, address, length, 0);
+}
+
+int lpm_withdraw_v6(lpm_table* table, const uint8_t address[16], unsigned int length) {
+	return update_live(table->engine6, table->table6, key_from_bytes(address), length, 0);
+}
+
+size_t lpm_prefixes(const lpm_table* table, int family) {
+	if( family == 6 ) {
+		const LiveTable<uint128>* live6 = dynamic_cast<const LiveTable<uint128>*>(table->engine6);
+		return live6 != NULL ? live6->count() : table->trie6.count();
+	}
+
+	const LiveTable<uint32_t>* live = dynamic_cast<const LiveTable<uint32_t>*>(table->engine);
+	return live != NULL ? live->count() : table->trie.count();
+}
@@ -0,0 +1,131 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef LPM_H
+#define	LPM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Library interface, for linking the lookups into other programs
+ *
+ * A table maps IPv4 and IPv6 addresses to the AS number of their longest
+ * matching prefix, 0 when nothing matches. Any number of threads may look
+ * up in it concurrently without locking, only lpm_close() must not race
+ * with them. Tables opened with the "live" engine also take route updates
+ * while being queried; lookups never wait for them, each one sees the
+ * table either before or after an update. Other tables never change.
+ *
+ * IPv4 addresses are host byte order integers (10.0.0.1 is 0x0A000001),
+ * IPv6 addresses 16 bytes in network order.
+ *
+ * Engine names are those of the -e option, NULL selects patricia.
+ *
+ * Engines other than patricia are built from the opened trie into memory
+ * of the calling process; with a shared table only patricia queries the
+ * shared pages in place.
+ *
+ * No C++ exception leaves these functions. The lpm_open_* functions
+ * return NULL on any failure: unknown engine, unreadable or invalid
+ * input, out of memory or threads that cannot be started; the table is
+ * released then.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lpm_table lpm_table;
+
+/** Parses a mapping file, "prefix/length AS" per line */
+lpm_table* lpm_open_mapping(const char* path, const char* engine);
+
+/** Maps the snapshots written by lpm -g, path.tree4 and path.tree6 */
+lpm_table* lpm_open_snapshot(const char* path, const char* engine, int verify);
+
+/** Attaches the newest generation published by lpm -g -p name */
+lpm_table* lpm_open_shared(const char* name, const char* engine, int verify);
+
+/**
+ * Generation of a shared table, 0 for other tables; lpm_stale() tells
+ * whether a newer one has been published since
+ */
+uint64_t lpm_generation(const lpm_table* table);
+int lpm_stale(const lpm_table* table);
+
+/**
+ * Attaches the newest generation of a shared table as a new table with
+ * the same engine, NULL for other tables or on failure. The old table
+ * stays valid; switch the threads over, then close it.
+ */
+lpm_table* lpm_reopen(const lpm_table* table, int verify);
+
+void lpm_close(lpm_table* table);
+
+uint32_t lpm_lookup_v4(const lpm_table* table, uint32_t address);
+uint32_t lpm_lookup_v6(const lpm_table* table, const uint8_t address[16]);
+
+void lpm_lookup_v4_batch(const lpm_table* table, const uint32_t* addresses, uint32_t* as, size_t count);
+void lpm_lookup_v6_batch(const lpm_table* table, const uint8_t (*addresses)[16], uint32_t* as, size_t count);
+
+/**
+ * Route updates, for tables with the "live" engine
+ * @return 1 when the prefix was added (announce) or removed (withdraw),
+ * 0 when it was replaced or not present, -1 when the table takes no
+ * updates, the arguments are invalid or memory ran out
+ */
+int lpm_announce_v4(lpm_table* table, uint32_t address, unsigned int length, uint32_t as);
+int lpm_announce_v6(lpm_table* table, const uint8_t address[16], unsigned int length, uint32_t as);
+int lpm_withdraw_v4(lpm_table* table, uint32_t address, unsigned int length);
+int lpm_withdraw_v6(lpm_table* table, const uint8_t address[16], unsigned int length);
+
+/** Number of prefixes of the family, 4 or 6 */
+size_t lpm_prefixes(const lpm_table* table, int family);
+
+#ifdef __cplusplus
+}
+
+
+/**
+ * Owning C++ handle of a table
+ */
+class LpmTable {
+
+	public:
+		explicit LpmTable(lpm_table* table) : table(table) {}
+		~LpmTable() { lpm_close(this->table); }
+
+		bool valid() const { return this->table != NULL; }
+		uint64_t generation() const { return lpm_generation(this->table); }
+		bool stale() const { return lpm_stale(this->table) != 0; }
+		lpm_table* reopen(const bool verify) const { return lpm_reopen(this->table, verify); }
+
+		uint32_t lookup(const uint32_t address) const { return lpm_lookup_v4(this->table, address); }
+		uint32_t lookup(const uint8_t address[16]) const { return lpm_lookup_v6(this->table, address); }
+
+		void lookup(const uint32_t* addresses, uint32_t* as, const size_t count) const { lpm_lookup_v4_batch(this->table, addresses, as, count); }
+		void lookup(const uint8_t (*addresses)[16], uint32_t* as, const size_t count) const { lpm_lookup_v6_batch(this->table, addresses, as, count); }
+
+		int announce(const uint32_t address, const unsigned int length, const uint32_t as) { return lpm_announce_v4(this->table, address, length, as); }
+		int announce(const uint8_t address[16], const unsigned int length, const uint32_t as) { return lpm_announce_v6(this->table, address, length, as); }
+		int withdraw(const uint32_t address, const unsigned int length) { return lpm_withdraw_v4(this->table, address, length); }
+		int withdraw(const uint8_t address[16], const unsigned int length) { return lpm_withdraw_v6(this->table, address, length); }
+
+	private:
+		LpmTable(const LpmTable&);
+		LpmTable& operator=(const LpmTable&);
+
+		lpm_table* table;
+
+};
+
+#endif
+
+#endif	/* LPM_H */
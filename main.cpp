@@ -10,14 +10,7 @@
 #define EXIT_HELP 2
 #define EXIT_MAPPING_EMPTY 3
 
-#define INPUT_BUFFER_SIZE 64
-#define IPV4_BUFFER_SIZE 16
-#define IPV4_BIN_BUFFER_SIZE 32
-#define IPV6_BUFFER_SIZE 39
-#define IPV6_BUFFER_SIZE_1 40
-#define IPV6_BIN_BUFFER_SIZE 128
-#define OUTPUT_BUFFER_SIZE 512
-#define OUTPUT_BUFFER_SIZE_SAFE 500
+#define BATCH_SIZE 64
 
 #define IPV6_DISABLED 0
 
@@ -26,6 +19,7 @@
 #else
 #include <sys/time.h>
 #endif //WIN32
+#include <signal.h>
 
 // std
 #include <stdlib.h>
@@ -35,14 +29,33 @@
 #include <cstring>
 #include <string>
 
+// threads
+#include <thread>
+#include <atomic>
+#include <functional>
+
 // streams
 #include <iostream>
 #include <fstream>
 #include <math.h>
 
 // data structures
-#include <bitset>
 #include "tree.h"
+#include "patricia.h"
+#include "lctrie.h"
+#include "live.h"
+#include "engines.h"
+#include "mapping.h"
+#include "cache.h"
+#include "astable.h"
+#include "snapshot.h"
+#include "pipeline.h"
+#include "parse.h"
+#include "probe.h"
+#include "server.h"
+#include "shared.h"
+#include "hugepage.h"
+#include "topology.h"
 
 #define MAX(a,b) (a > b ? a : b)
 #define MIN(a,b) (a < b ? a : b)
@@ -50,9 +63,6 @@
 
 using namespace std;
 
-double treetime = 0;
-double converttime = 0;
-
 /**
  * Prints help message onto stderr
  */
@@ -63,303 +73,541 @@ void printHelp(void) {
 	cerr << "Usage:" << endl;
 	cerr << "\tlpm -i mapping_file_path < ip.txt\t\t... IP matching" << endl;
 	cerr << "\tlpm -g mapping_file_path\t\t\t... generate trees" << endl;
+	cerr << "\tlpm -i mapping_file_path -l socket_path\t... serve lookups on Unix socket" << endl;
+	cerr << "\tlpm -q socket_path < ip.txt\t\t... IP matching by running server" << endl;
+	cerr << "\tlpm -u socket_path < updates.txt\t\t... announce \"prefix/length AS\", withdraw" << endl;
+	cerr << "\t\t\t\t\t    \"prefix/length\" at a server with -e live" << endl << endl;
+	cerr << "Options:" << endl;
+	cerr << "\t-e ENGINE\t\t\t\t... lookup engine: patricia, dir248 (IPv4), poptrie (IPv6)," << endl;
+	cerr << "\t\t\t\t\t    live, compact (vEB order), compact-bfs," << endl;
+	cerr << "\t\t\t\t\t    lctrie[:fill factor] (default 0.5)" << endl;
+	cerr << "\t-V\t\t\t\t\t... verify snapshot checksum on load" << endl;
+	cerr << "\t-j N\t\t\t\t\t... match on N threads, build the tables on N threads" << endl;
+	cerr << "\t\t\t\t\t    (default all cores)" << endl;
+	cerr << "\t-c N[:lru|:clock]\t\t\t... cache N results per thread and family" << endl;
+	cerr << "\t-l SOCKET\t\t\t\t... serve lookups on Unix socket until SIGINT/SIGTERM" << endl;
+	cerr << "\t-p NAME\t\t\t\t\t... with -g, also publish the table to shared memory" << endl;
+	cerr << "\t-a NAME\t\t\t\t\t... use the table published to shared memory," << endl;
+	cerr << "\t\t\t\t\t    a server follows newer generations" << endl;
+	cerr << "\t-m thp|2m|1g\t\t\t\t... back the lookup tables by huge pages" << endl;
+	cerr << "\t-n\t\t\t\t\t... one table replica per NUMA node, workers" << endl;
+	cerr << "\t\t\t\t\t    bound to the node of their replica" << endl;
 	cerr << "See https://wis.fit.vutbr.cz/FIT/st/course-sl.php?id=503602&item=41654";
 }
 
 
-void ipv4_char(const char* ip, char* out, const unsigned int limit) {
-	unsigned int n = 0;
-	unsigned int m = 0;
-	char buffer[4];
-	bitset<8> bits;
-
-	const unsigned int length = strlen(ip);
-	for(unsigned int i = 0; i <= length; ++i) {
-		if( ip[i] == '.' || i == length ) {
-			buffer[n] = '\0';
-			bits = bitset<8>(atol(buffer));
-			for(int j=7;j >= 0; --j) {
-				out[m++] = bits[j] + 48;
-				if( m >= limit ) {
-					i = length;
-					break;
-				}
-			}
+template<typename K>
+void buildReplica(const Topology& topology, const unsigned int node, LookupEngine<K>* (*create)(const string&), const string& name, const vector<prefixEntry<K> >& prefixes, LookupEngine<K>*& replica) {
+	topology.bind(node);
 
-			n = 0;
-			continue;
-		}
-
-		buffer[n++] = ip[i];
+	replica = create(name);
+	if( replica == NULL ) {
+		replica = new PatriciaTrie<K>();
 	}
-
-	out[m] = '\0';
+	replica->build(prefixes);
 }
 
-
-inline void ipv4_char_opt(const char* ip, char* out, const unsigned int length) {
-	unsigned int n = 0;
-	unsigned int m = 0;
-	int j;
-	char buffer[4];
-	bitset<8> bits;
-
-	for(unsigned int i = 0; i < length; ++i) {
-		if( ip[i] == '.' ) {
-			buffer[n] = '\0';
-			bits = bitset<8>(atol(buffer));
-			for(j=7;j >= 0;--j) {
-				out[m++] = bits[j] + 48;
-			}
-
-			n = 0;
-			continue;
-		}
-
-		buffer[n++] = ip[i];
+/**
+ * Builds one copy of the engine per NUMA node, each by a thread bound to
+ * its node, so that the pages are first touched and placed there
+ */
+template<typename K>
+void buildReplicas(const Topology& topology, LookupEngine<K>* (*create)(const string&), const string& name, const PatriciaTrie<K>& trie, vector<LookupEngine<K>*>& replicas) {
+	vector<prefixEntry<K> > prefixes;
+	trie.prefixes(prefixes);
+
+	replicas.assign(topology.nodes(), NULL);
+	vector<thread> builders;
+	for(unsigned int node = 0; node < topology.nodes(); ++node) {
+		builders.push_back(thread(buildReplica<K>, std::cref(topology), node, create, std::cref(name), std::cref(prefixes), std::ref(replicas[node])));
 	}
-
-	// i == length
-	buffer[n] = '\0';
-	bits = bitset<8>(atol(buffer));
-	for(j=7;j >= 0;--j) {
-		out[m++] = bits[j] + 48;
+	for(unsigned int i = 0; i < builders.size(); ++i) {
+		builders[i].join();
 	}
-
-	out[IPV4_BIN_BUFFER_SIZE] = '\0';
 }
 
-inline string ipv4_string(const string input) {
-	char output[IPV4_BIN_BUFFER_SIZE + 1];
-	ipv4_char(input.c_str(), output, IPV4_BIN_BUFFER_SIZE);
-	return string(output);
-}
-
-void ipv6_char(const char* ip, char* out, const unsigned int limit) {
-	unsigned int n = 0;
-	unsigned int m = 0;
-	unsigned int dotsTotal = 0;
-	char buffer[4];
-	bitset<16> bits;
-
-	unsigned int i;
-	const unsigned int length = strlen(ip);
-
-	for(i = 0; i <= length; i++) {
-		if( ip[i] == ':' ) {
+typedef struct matchContext {
+	const LookupEngine<uint32_t>* engine;
+	const LookupEngine<uint128>* engine6;
+	const AsTable* table;
+	const AsTable* table6;
+	const Topology* topology;
+	vector<LookupEngine<uint32_t>*> replicas;
+	vector<LookupEngine<uint128>*> replicas6;
+	vector<FlowCache<uint32_t>*> caches;
+	vector<FlowCache<uint128>*> caches6;
+	LookupHistogram* histograms;
+	LookupHistogram* histograms6;
+} matchContext;
 
-			if( ip[i - 1] == ':' ) {
-				dotsTotal--;
+/**
+ * Matches every line of the block, appends one result line per input line
+ * @param context matchContext with engines and AS tables to query
+ * @param worker selects the flow caches, histograms and NUMA replicas, when enabled
+ */
+unsigned int matchBlock(const char* data, const size_t length, vector<char>& output, void* context, const unsigned int worker) {
+	const matchContext* engines = (const matchContext*)context;
+	const LookupEngine<uint32_t>* engine = engines->replicas.empty() ? engines->engine : engines->replicas[engines->topology->node(worker)];
+	const LookupEngine<uint128>* engine6 = engines->replicas6.empty() ? engines->engine6 : engines->replicas6[engines->topology->node(worker)];
+	FlowCache<uint32_t>* cache = engines->caches.empty() ? NULL : engines->caches[worker];
+	FlowCache<uint128>* cache6 = engines->caches6.empty() ? NULL : engines->caches6[worker];
+
+	const char* texts[BATCH_SIZE];
+	size_t lengths[BATCH_SIZE];
+	bool valid[BATCH_SIZE];
+	bool valid6[BATCH_SIZE];
+	uint32_t keys[BATCH_SIZE];
+	uint128 keys6[BATCH_SIZE];
+	unsigned int located[BATCH_SIZE];
+	unsigned int located6[BATCH_SIZE];
+	bool ipv4[BATCH_SIZE];
+
+	const char* position = data;
+	const char* end = data + length;
+	const char* line;
+	size_t size;
+	unsigned int lines, count, count6;
+	unsigned int total = 0;
+
+	while( position < end ) {
+
+		// parse batch of lines
+		lines = 0;
+		count = 0;
+		count6 = 0;
+
+		while( lines < BATCH_SIZE && next_line(position, end, line, size) ) {
+			ipv4[lines] = is_ipv4(line, size);
+			if( ipv4[lines] ) {
+				texts[count] = line;
+				lengths[count++] = size;
 			} else {
-				dotsTotal++;
+				valid6[count6] = ipv6_parse(line, size, keys6[count6]);
+				count6++;
 			}
 
+			lines++;
 		}
-	}
 
-	for(i = 0; i <= length; i++) {
-		if( ip[i] == ':' || i == length ) {
+		// perform matching, malformed addresses match nothing
+		const bool allValid = ipv4_parse_batch(texts, lengths, keys, valid, count) == count;
 
-			// handle double dot
-			if( ip[i] == ':' && ip[i - 1] == ':' ) {
+		// the parsers leave the key of a malformed line unset, keep it out of the cache
+		for(unsigned int i = 0; !allValid && i < count; ++i) {
+			if( !valid[i] ) {
+				keys[i] = 0;
+			}
+		}
+		for(unsigned int i = 0; i < count6; ++i) {
+			if( !valid6[i] ) {
+				keys6[i] = uint128();
+			}
+		}
 
-				if( i + 1 == length ) {
-					for(;m < limit; m++ ) {
-						out[m] = '0';
-					}
-					i = length;
-					break;
-				} else {
+		if( cache != NULL ) {
+			cache->lookup(engine, keys, located, count);
+			cache6->lookup(engine6, keys6, located6, count6);
+		} else {
+			engine->findBatch(keys, located, count);
+			engine6->findBatch(keys6, located6, count6);
+		}
 
-					const unsigned int dec = i == length ? 0 : 16;
-					const unsigned int zerosRemaining = MIN( m + (7 - dotsTotal) * 16 - dec, limit ) - m;
-					for(unsigned int dd = 0; dd < zerosRemaining; dd++) {
-						out[m++] = '0';
-					}
+		// debug statistics, the first lookup of every batch is traced once more
+		if( engines->histograms != NULL ) {
+			unsigned int visited, depth;
+			if( count > 0 && valid[0] && (visited = engine->trace(keys[0], depth)) != 0 ) {
+				engines->histograms[worker].add(visited, depth);
+			}
+			if( count6 > 0 && valid6[0] && (visited = engine6->trace(keys6[0], depth)) != 0 ) {
+				engines->histograms6[worker].add(visited, depth);
+			}
+		}
 
-					continue;
-				}
+		for(unsigned int i = 0; !allValid && i < count; ++i) {
+			if( !valid[i] ) {
+				located[i] = 0;
 			}
+		}
+		for(unsigned int i = 0; i < count6; ++i) {
+			if( !valid6[i] ) {
+				located6[i] = 0;
+			}
+		}
 
-			// parse normal data
-			buffer[n] = '\0';
-			bits = bitset<16>(strtol(buffer, NULL, 16));
+		// set output, whole pre-rendered entries are copied
+		size_t buffered = output.size();
+		output.resize(buffered + lines * AsTable::ENTRY_SIZE);
+		char* obuffer = &output[0];
 
-			for(int j=15;j >= 0;--j) {
-				out[m++] = bits[j] + 48;
-				if( m >= limit ) {
-					i = length;
-					break;
-				}
-			}
+		count = 0;
+		count6 = 0;
+		for(unsigned int i = 0; i < lines; ++i) {
+			const asEntry& entry = ipv4[i] ? engines->table->entry(located[count++]) : engines->table6->entry(located6[count6++]);
 
-			n = 0;
-			continue;
+			memcpy(obuffer + buffered, &entry, AsTable::ENTRY_SIZE);
+			buffered += entry.length;
 		}
 
-		buffer[n++] = ip[i];
+		output.resize(buffered);
+		total += lines;
 	}
 
-	out[m] = '\0';
+	return total;
 }
 
-inline string ipv6_string(const string input) {
-	char output[IPV6_BIN_BUFFER_SIZE + 1];
-	ipv6_char(input.c_str(), output, IPV6_BIN_BUFFER_SIZE);
-	return string(output);
+/**
+ * Binds the worker to the node of the replica it matches with
+ */
+void pinWorker(void* context, const unsigned int worker) {
+	const matchContext* engines = (const matchContext*)context;
+	if( !engines->replicas.empty() ) {
+		engines->topology->bind(engines->topology->node(worker));
+	}
 }
 
-inline void ipv6_char_opt(const char* ip, char* out, const unsigned int length) {
-	unsigned int n = 0;
-	unsigned int m = 0;
-	unsigned int dotsTotal = 0;
-	char buffer[4];
-	bitset<16> bits;
 
-	unsigned int i;
+typedef struct queryContext {
+	vector<LookupClient*> clients;
+	volatile bool failed;
+} queryContext;
 
-	for(i = 0; i <= length; i++) {
-		if( ip[i] == ':' ) {
+/**
+ * Writes "AS\n", or "-\n" for no match
+ */
+static size_t render_as(char* output, uint32_t as) {
+	char digits[10];
+	size_t count = 0;
 
-			if( ip[i - 1] == ':' ) {
-				dotsTotal--;
-			} else {
-				dotsTotal++;
+	if( as == 0 ) {
+		memcpy(output, "-\n", 2);
+		return 2;
+	}
+
+	while( as > 0 ) {
+		digits[count++] = '0' + as % 10;
+		as /= 10;
+	}
+	for(size_t i = 0; i < count; ++i) {
+		output[i] = digits[count - 1 - i];
+	}
+	output[count] = '\n';
+	return count + 1;
+}
+
+/**
+ * Like matchBlock, but the lookups are done by a server
+ * @param context queryContext with one connection per worker
+ */
+unsigned int queryBlock(const char* data, const size_t length, vector<char>& output, void* context, const unsigned int worker) {
+	queryContext* query = (queryContext*)context;
+	LookupClient* client = query->clients[worker];
+
+	vector<uint32_t> keys, results;
+	vector<uint128> keys6;
+	vector<uint32_t> results6;
+	vector<char> kinds;
+
+	const char* position = data;
+	const char* end = data + length;
+	const char* line;
+	size_t size;
+
+	// malformed addresses are not sent, they match nothing
+	while( next_line(position, end, line, size) ) {
+		uint32_t key;
+		uint128 key6;
+
+		if( is_ipv4(line, size) ) {
+			kinds.push_back(ipv4_parse(line, size, key) ? 4 : 0);
+			if( kinds.back() != 0 ) {
+				keys.push_back(key);
 			}
+		} else {
+			kinds.push_back(ipv6_parse(line, size, key6) ? 6 : 0);
+			if( kinds.back() != 0 ) {
+				keys6.push_back(key6);
+			}
+		}
+	}
 
+	results.resize(keys.size());
+	results6.resize(keys6.size());
+	if( (!keys.empty() && !client->query(&keys[0], &results[0], keys.size()))
+		|| (!keys6.empty() && !client->query(&keys6[0], &results6[0], keys6.size())) ) {
+		if( !query->failed ) {
+			cerr << "Lookup server connection lost" << endl;
 		}
+		query->failed = true;
+		return 0;
 	}
 
-	for(i = 0; i <= length; i++) {
-		if( ip[i] == ':' || i == length ) {
+	size_t buffered = output.size();
+	output.resize(buffered + kinds.size() * 12);
 
-			// handle double dot
-			if( ip[i] == ':' && i > 0 && ip[i - 1] == ':' ) {
+	size_t next = 0, next6 = 0;
+	for(size_t i = 0; i < kinds.size(); ++i) {
+		const uint32_t as = kinds[i] == 4 ? results[next++] : (kinds[i] == 6 ? results6[next6++] : 0);
+		buffered += render_as(&output[buffered], as);
+	}
 
-				const unsigned int dec = i == length ? 0 : 16;
-				const unsigned int zerosRemaining = MIN( m + (7 - dotsTotal) * 16 - dec, IPV6_BIN_BUFFER_SIZE ) - m;
-				for(unsigned int dd = 0; dd < zerosRemaining; dd++) {
-					out[m++] = '0';
-				}
+	output.resize(buffered);
+	return kinds.size();
+}
 
-				continue;
-			}
+/**
+ * Parses decimal number at most limit, within [p, end)
+ * @return position after the digits, NULL for no digits or overflow
+ */
+static const char* parse_decimal(const char* p, const char* end, const uint64_t limit, uint64_t& number) {
+	const char* start = p;
+	number = 0;
+	while( p < end && *p >= '0' && *p <= '9' ) {
+		number = number * 10 + (*p - '0');
+		if( number > limit ) {
+			return NULL;
+		}
+		p++;
+	}
+	return p == start ? NULL : p;
+}
 
-			// parse normal data
-			buffer[n] = '\0';
-			bits = bitset<16>(strtol(buffer, NULL, 16));
+static const char* skip_blanks(const char* p, const char* end) {
+	while( p < end && (*p == ' ' || *p == '\t' || *p == '\r') ) {
+		p++;
+	}
+	return p;
+}
 
-			for(int j=15;j >= 0;--j) {
-				out[m++] = bits[j] + 48;
-			}
+/**
+ * Parses "prefix/length AS", or "prefix/length" alone for a withdrawal
+ * (AS 0); any other AS field than a 32-bit number makes the line malformed
+ */
+template<typename R>
+static bool parse_update(const char* line, const size_t size, R& update) {
+	const char* last = line + size;
+	const char* slash = (const char*)memchr(line, '/', size);
+	if( slash == NULL || !ip_parse(line, slash - line, update.key) ) {
+		return false;
+	}
 
-			n = 0;
-			continue;
-		}
+	uint64_t number;
+	const char* p = parse_decimal(slash + 1, last, key_width(update.key), number);
+	if( p == NULL || (p < last && *p != ' ' && *p != '\t' && *p != '\r') ) {
+		return false;
+	}
+	update.length = number;
 
-		if( n < 4 ) {
-			buffer[n++] = ip[i];
-		}
+	p = skip_blanks(p, last);
+	if( p == last ) {
+		update.as = 0;
+		return true;
 	}
 
-	out[IPV6_BIN_BUFFER_SIZE] = '\0';
+	p = parse_decimal(p, last, 0xFFFFFFFF, number);
+	if( p == NULL || number == 0 || skip_blanks(p, last) != last ) {
+		return false;
+	}
+	update.as = number;
+	return true;
 }
 
-
-
 /**
- * Loads data from given file path
- * @param filePath
+ * Sends the route updates of the block to a server, writes "1\n" where
+ * a prefix was added or withdrawn, "0\n" otherwise, "-\n" for malformed lines
+ * @param context queryContext with one connection per worker
  */
-void loadMappingFile(const string filePath, RadixTrie& tree, RadixTrie& tree6) {
-	ifstream file;
-
-	char buffer[INPUT_BUFFER_SIZE];
-	unsigned int bufferLength;
+unsigned int updateBlock(const char* data, const size_t length, vector<char>& output, void* context, const unsigned int worker) {
+	queryContext* query = (queryContext*)context;
+	LookupClient* client = query->clients[worker];
+
+	vector<routeUpdate4> updates;
+	vector<routeUpdate6> updates6;
+	vector<uint32_t> results, results6;
+	vector<char> kinds;
+
+	const char* position = data;
+	const char* end = data + length;
+	const char* line;
+	size_t size;
+
+	while( next_line(position, end, line, size) ) {
+		routeUpdate4 update;
+		routeUpdate6 update6;
+
+		if( is_ipv4(line, size) ) {
+			kinds.push_back(parse_update(line, size, update) ? 4 : 0);
+			if( kinds.back() != 0 ) {
+				updates.push_back(update);
+			}
+		} else {
+			kinds.push_back(parse_update(line, size, update6) ? 6 : 0);
+			if( kinds.back() != 0 ) {
+				updates6.push_back(update6);
+			}
+		}
+	}
 
-	char buffer2[IPV4_BIN_BUFFER_SIZE + 1];
-	char buffer3[IPV6_BIN_BUFFER_SIZE + 1];
+	results.resize(updates.size());
+	results6.resize(updates6.size());
+	if( (!updates.empty() && !client->update(&updates[0], &results[0], updates.size()))
+		|| (!updates6.empty() && !client->update(&updates6[0], &results6[0], updates6.size())) ) {
+		if( !query->failed ) {
+			cerr << "Lookup server refused the updates or connection lost" << endl;
+		}
+		query->failed = true;
+		return 0;
+	}
 
-	char ip[IPV6_BUFFER_SIZE_1];
+	output.reserve(output.size() + kinds.size() * 2);
+	size_t next = 0, next6 = 0;
+	for(size_t i = 0; i < kinds.size(); ++i) {
+		const char result = kinds[i] == 0 ? '-' : ((kinds[i] == 4 ? results[next++] : results6[next6++]) != 0 ? '1' : '0');
+		output.push_back(result);
+		output.push_back('\n');
+	}
 
-	char mask[8];
-	unsigned char maskLength;
-	char as[9];
-	unsigned char asLength;
+	return kinds.size();
+}
 
-	bool ipv6;
-	char phase;
-	double start;
+/**
+ * Lets the server take route updates when it serves live tables
+ */
+void accept_updates(LookupServer& server, LookupEngine<uint32_t>* engine, LookupEngine<uint128>* engine6, AsTable& table, AsTable& table6) {
+	LiveTable<uint32_t>* live = dynamic_cast<LiveTable<uint32_t>*>(engine);
+	LiveTable<uint128>* live6 = dynamic_cast<LiveTable<uint128>*>(engine6);
+	server.acceptUpdates(live, live6, live != NULL ? &table : NULL, live6 != NULL ? &table6 : NULL);
+}
 
-	try {
-		file.open(filePath.c_str(), ifstream::in);
 
-		while(file.eof() == false) {
-			file.getline(buffer, INPUT_BUFFER_SIZE);
+/**
+ * Generation of a shared table the server switched to
+ */
+typedef struct tableVersion {
+	SharedTable shared;
+	PatriciaTrie<uint32_t> trie;
+	PatriciaTrie<uint128> trie6;
+	AsTable table;
+	AsTable table6;
+	LookupEngine<uint32_t>* engine;
+	LookupEngine<uint128>* engine6;
+} tableVersion;
+
+typedef struct reloadContext {
+	string name;
+	string engineName;
+	bool verify;
+	SharedTable* initial;
+	PatriciaTrie<uint32_t>* trie;
+	PatriciaTrie<uint128>* trie6;
+	LookupEngine<uint32_t>* engine;
+	LookupEngine<uint128>* engine6;
+	tableVersion* current;
+
+	/** Builds the next version off the server thread */
+	std::thread builder;
+	bool building;
+	std::atomic<bool> ready;
+	tableVersion* next;
+} reloadContext;
+
+void release_version(tableVersion* version) {
+	if( version->engine != &version->trie ) {
+		delete version->engine;
+	}
+	if( version->engine6 != &version->trie6 ) {
+		delete version->engine6;
+	}
+	delete version;
+}
 
-			ipv6 = false;
-			phase = 0;
-			maskLength = 0;
-			asLength = 0;
-			bufferLength = strlen(buffer);
+/**
+ * Attaches the newest generation and builds its engines, leaves NULL in
+ * next when it cannot be attached
+ */
+void build_version(reloadContext* reload) {
+	tableVersion* next = new tableVersion;
+	if( next->shared.attach(reload->name, next->trie, next->table, next->trie6, next->table6, reload->verify) ) {
+		next->engine = resolveEngine(createEngine4(reload->engineName), next->trie);
+		next->engine6 = resolveEngine(createEngine6(reload->engineName), next->trie6);
+	} else {
+		delete next;
+		next = NULL;
+	}
 
-			if( bufferLength == 0 ) {
-				break;
-			}
+	reload->next = next;
+	reload->ready.store(true, std::memory_order_release);
+}
 
-			for(unsigned int i = 0; i < bufferLength; i++) {
+/**
+ * Waits for a build still running, drops its result
+ */
+void finish_reload(reloadContext* reload) {
+	if( !reload->building ) {
+		return;
+	}
 
-				if( buffer[i] == ':' ) {
-					ipv6 = true;
-				}
+	reload->builder.join();
+	reload->building = false;
+	if( reload->next != NULL ) {
+		release_version(reload->next);
+		reload->next = NULL;
+	}
+}
 
-				if( phase == 0 ) {
-					if( buffer[i] == '/' ) {
-						phase = 1;
-						ip[i] = '\0';
-					} else {
-						ip[i] = buffer[i];
-					}
-				} else if( phase == 1 ) {
-					if( buffer[i] == ' ' ) {
-						phase = 2;
-						mask[maskLength] = '\0';
-					} else {
-						mask[maskLength++] = buffer[i];
-					}
-				} else if( buffer[i] >= '0' && buffer[i] <= '9' ) {
-					as[asLength++] = buffer[i];
-				}
-			}
-			as[asLength] = '\0';
+/**
+ * Server tick, starts building a newly published generation and switches
+ * to it once built; of the initial table owned by main, the mapping and a
+ * built engine are released
+ */
+void reloadTable(LookupServer& server, void* context) {
+	reloadContext* reload = (reloadContext*)context;
+
+	if( !reload->building ) {
+		const SharedTable& shared = reload->current != NULL ? reload->current->shared : *reload->initial;
+		if( shared.stale() ) {
+			reload->ready.store(false);
+			reload->next = NULL;
+			reload->builder = std::thread(build_version, reload);
+			reload->building = true;
+		}
+		return;
+	}
 
-			if( ipv6 == true) {
-				start = getTime();
-				ipv6_char(ip, buffer3, atoi(mask));
-				converttime += getTime() - start;
+	if( !reload->ready.load(std::memory_order_acquire) ) {
+		return;
+	}
 
-				start = getTime();
-				tree6.insert(buffer3, (unsigned int)atoi(as));
-				treetime += getTime() - start;
-			} else {
-				start = getTime();
-				ipv4_char(ip, buffer2, atoi(mask));
-				converttime += getTime() - start;
+	reload->builder.join();
+	reload->building = false;
+	tableVersion* next = reload->next;
+	reload->next = NULL;
+	if( next == NULL ) {
+		return;
+	}
 
-				start = getTime();
-				tree.insert(buffer2, (unsigned int)atoi(as));
-				treetime += getTime() - start;
-			}
+	server.use(next->engine, next->engine6, &next->table, &next->table6);
+	accept_updates(server, next->engine, next->engine6, next->table, next->table6);
 
-			buffer[0] = '\0';
-			bufferLength = 0;
+	if( reload->current != NULL ) {
+		release_version(reload->current);
+	} else {
+		reload->initial->detach();
+		if( reload->engine != reload->trie ) {
+			delete reload->engine;
+		}
+		if( reload->engine6 != reload->trie6 ) {
+			delete reload->engine6;
 		}
-	} catch (const ifstream::failure &e) {
-		cerr << "Exception opening/reading file: ";
-		cerr << e.what();
 	}
+	reload->current = next;
+}
 
-	file.close();
+LookupServer* activeServer = NULL;
+
+void stopServer(int) {
+	if( activeServer != NULL ) {
+		activeServer->stop();
+	}
 }
 
 
@@ -373,22 +621,40 @@ int main(int argc, char** argv) {
 
 	// source data
 	string inputFilePath, inputTempPath4, inputTempPath6;
-	RadixTrie tree, tree6;
-
+	PatriciaTrie<uint32_t> trie;
+	PatriciaTrie<uint128> trie6;
+	Snapshot snapshot4, snapshot6;
+	AsTable table, table6;
+	LookupEngine<uint32_t>* engine;
+	LookupEngine<uint128>* engine6;
+	string engineName("patricia");
+	bool verify = false;
 
 	// debugging
 	bool debug = false;
 	bool simpleDebug = false;
 	bool forceGenerate = false;
-	double time, sstart;
+	double time = 0, sstart = 0;
+	Probe loadProbe("load"), deserializeProbe("deserialize"), matchProbe("match");
 	unsigned int mapped = 0;
 
 	// io
-	ifstream inputFile;
-	unsigned int buffered = 0;
+	unsigned int workers = 1;
+	unsigned int builders = std::thread::hardware_concurrency();
+	unsigned int cacheSize = 0;
+	FlowCache<uint32_t>::replacement cachePolicy = FlowCache<uint32_t>::REPLACE_CLOCK;
+	string socketPath;
+	bool client = false;
+	bool updating = false;
+	string publishName, sharedName;
+	SharedTable shared;
+
+	// memory placement
+	pagePolicy pages = PAGES_DEFAULT;
+	bool replicate = false;
 
 	// handle command line options
-	if( argc < 3 || (strcmp(argv[1], "-i") != 0 && strcmp(argv[1], "-d") != 0 && strcmp(argv[1], "-g") != 0 && strcmp(argv[1], "-s") != 0)) {
+	if( argc < 3 || (strcmp(argv[1], "-i") != 0 && strcmp(argv[1], "-d") != 0 && strcmp(argv[1], "-g") != 0 && strcmp(argv[1], "-s") != 0 && strcmp(argv[1], "-q") != 0 && strcmp(argv[1], "-u") != 0)) {
 		printHelp();
 		return EXIT_HELP;
 	} else {
@@ -403,51 +669,175 @@ int main(int argc, char** argv) {
 			forceGenerate = true;
 		}  else if( strcmp(argv[1], "-s") == 0 ) {
 			simpleDebug = true;
+		} else if( strcmp(argv[1], "-q") == 0 || strcmp(argv[1], "-u") == 0 ) {
+			client = true;
+			updating = strcmp(argv[1], "-u") == 0;
+			socketPath = inputFilePath;
+		}
+
+		// optional switches
+		for(int a = 3; a < argc; ++a) {
+			if( strcmp(argv[a], "-e") == 0 && a + 1 < argc ) {
+				engineName = string(argv[++a]);
+			} else if( strcmp(argv[a], "-V") == 0 ) {
+				verify = true;
+			} else if( strcmp(argv[a], "-j") == 0 && a + 1 < argc && atoi(argv[a + 1]) > 0 ) {
+				workers = atoi(argv[++a]);
+				builders = workers;
+			} else if( strcmp(argv[a], "-l") == 0 && a + 1 < argc && !client ) {
+				socketPath = string(argv[++a]);
+			} else if( strcmp(argv[a], "-p") == 0 && a + 1 < argc ) {
+				publishName = string(argv[++a]);
+			} else if( strcmp(argv[a], "-a") == 0 && a + 1 < argc ) {
+				sharedName = string(argv[++a]);
+			} else if( strcmp(argv[a], "-m") == 0 && a + 1 < argc && parse_page_policy(argv[a + 1], pages) ) {
+				set_page_policy(pages);
+				a++;
+			} else if( strcmp(argv[a], "-n") == 0 ) {
+				replicate = true;
+			} else if( strcmp(argv[a], "-c") == 0 && a + 1 < argc && atoi(argv[a + 1]) > 0 ) {
+				const char* policy = strchr(argv[++a], ':');
+				cacheSize = atoi(argv[a]);
+				if( policy != NULL && strcmp(policy, ":lru") == 0 ) {
+					cachePolicy = FlowCache<uint32_t>::REPLACE_LRU;
+				} else if( policy != NULL && strcmp(policy, ":clock") != 0 ) {
+					printHelp();
+					return EXIT_HELP;
+				}
+			} else {
+				printHelp();
+				return EXIT_HELP;
+			}
 		}
 	}
 
+	// lookups by a running server, updates in input order
+	if( client ) {
+		if( updating ) {
+			workers = 1;
+		}
+
+		queryContext context;
+		context.failed = false;
+		for(unsigned int w = 0; w < (workers > 0 ? workers : 1); ++w) {
+			context.clients.push_back(new LookupClient());
+			if( !context.clients.back()->connect(socketPath) ) {
+				cerr << "Cannot connect to " << socketPath << endl;
+				return EXIT_FAILURE;
+			}
+		}
+
+		InputReader input(stdin);
+		Pipeline pipeline(workers, updating ? updateBlock : queryBlock, &context);
+		if( !pipeline.run(input, stdout) ) {
+			cerr << "Cannot write output" << endl;
+			context.failed = true;
+		}
+
+		for(unsigned int w = 0; w < context.clients.size(); ++w) {
+			delete context.clients[w];
+		}
+		return context.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	// engines available for one family only fall back to patricia for the other
+	engine = createEngine4(engineName);
+	engine6 = createEngine6(engineName);
+	if( engine == NULL && engine6 == NULL ) {
+		printHelp();
+		return EXIT_HELP;
+	}
+
+	// with one replica per node the workers never query the engine itself
+	Topology topology;
+	const bool replicated = replicate && topology.nodes() > 1;
+
 	// init measure load time
 	if( debug ) {
 		time = getTime();
 		sstart = getTime();
+		deserializeProbe.open();
+		deserializeProbe.start();
 	}
 
-	// load data
-	ifstream serialized4(inputTempPath4.c_str());
-	ifstream serialized6(inputTempPath6.c_str());
+	// load data, a published table replaces the snapshot files
+	const bool loaded = forceGenerate == false && (sharedName.empty()
+		? snapshot_load(snapshot4, inputTempPath4, trie, table, verify) && snapshot_load(snapshot6, inputTempPath6, trie6, table6, verify)
+		: shared.attach(sharedName, trie, table, trie6, table6, verify));
 
-	if( forceGenerate == false && serialized4 && serialized6 ) {
-		tree.parseFrom(serialized4, IPV4_BIN_BUFFER_SIZE + 1);
-		tree6.parseFrom(serialized6, IPV6_BIN_BUFFER_SIZE + 1);
+	if( !loaded && !sharedName.empty() && forceGenerate == false ) {
+		cerr << "Cannot attach shared table " << sharedName << endl;
+		return EXIT_FAILURE;
+	} else if( loaded ) {
 
 		if( debug ) {
-			cerr << endl << "Deserialization time: " << ROUND((getTime() - sstart)*1000,5) << " ms" << endl;
+			cerr << endl << "Snapshot load time: " << ROUND((getTime() - sstart)*1000,5) << " ms" << endl;
+		}
+
+		// integer lookup engines, replicas are built from the trie later
+		if( replicated && socketPath.empty() ) {
+			delete engine;
+			delete engine6;
+			engine = &trie;
+			engine6 = &trie6;
+		} else {
+			engine = resolveEngine(engine, trie);
+			engine6 = resolveEngine(engine6, trie6);
 		}
 
-		serialized4.close();
-		serialized6.close();
+		if( debug ) {
+			deserializeProbe.stop();
+			cerr << "Build time (" << engine->name() << ", " << engine6->name() << "): " << ROUND((getTime() - sstart)*1000,5) << " ms" << endl;
+			cerr << "Engine size: " << engine->size() << " + " << engine6->size() << " B" << endl;
+			if( dynamic_cast<LcTrie<uint32_t>*>(engine) != NULL ) {
+				cerr << "LC-trie depth: " << ((LcTrie<uint32_t>*)engine)->averageDepth() << " + " << ((LcTrie<uint128>*)engine6)->averageDepth() << endl;
+			}
+			cerr << "IPv4 parser: " << ipv4_parser_name() << endl;
+			deserializeProbe.report(cerr);
+		}
 	} else {
-		serialized4.close();
-		serialized6.close();
+		snapshot4.close();
+		snapshot6.close();
+		delete engine;
+		delete engine6;
 
-		// load
-		loadMappingFile(inputFilePath, tree, tree6);
+		if( debug ) {
+			loadProbe.open();
+			loadProbe.start();
+		}
+
+		// load, the tries are built straight from the prefix lists, partitioned over the threads
+		vector<prefixEntry<uint32_t> > prefixes;
+		vector<prefixEntry<uint128> > prefixes6;
+		if( !loadMappingFile(inputFilePath, prefixes, prefixes6, table, table6, builders > 0 ? builders : 1) ) {
+			cerr << "Cannot open mapping file " << inputFilePath << endl;
+			return EXIT_FAILURE;
+		}
+
+		build_tries(trie, prefixes, trie6, prefixes6, builders > 0 ? builders : 1);
 
 		// serialize
-		unsigned int total4 = 0;
-		ofstream serialize4(inputTempPath4.c_str(), ios_base::trunc);
-		tree.serialize(serialize4, tree.getRoot(), &total4);
-		serialize4.close();
+		if( !snapshot_save(inputTempPath4, trie, table) || !snapshot_save(inputTempPath6, trie6, table6) ) {
+			cerr << "Cannot write snapshot " << inputTempPath4 << ", " << inputTempPath6 << endl;
+			return EXIT_FAILURE;
+		}
 
-		unsigned int total6 = 0;
-		ofstream serialize6(inputTempPath6.c_str(), ios_base::trunc);
-		tree6.serialize(serialize6, tree6.getRoot(), &total6);
-		serialize6.close();
+		uint64_t generation;
+		if( !publishName.empty() && !SharedTable::publish(publishName, trie, table, trie6, table6, generation) ) {
+			cerr << "Cannot publish shared table " << publishName << endl;
+			return EXIT_FAILURE;
+		}
 
 		if( debug ) {
+			loadProbe.stop();
 			cerr << endl << "Serialization time: " << ROUND((getTime() - sstart)*1000,5) << " ms" << endl;
-			cerr << "Total IPv4: " << total4 << " " << tree.count() << endl;
-			cerr << "Total IPv6: " << total6 << " " << tree6.count() << endl << endl;
+			cerr << "Total IPv4: " << trie.nodeCount() << " " << trie.count() << endl;
+			cerr << "Total IPv6: " << trie6.nodeCount() << " " << trie6.count() << endl;
+			if( !publishName.empty() ) {
+				cerr << "Published generation: " << generation << endl;
+			}
+			loadProbe.report(cerr);
+			cerr << endl;
 		}
 
 		return 0;
@@ -455,94 +845,101 @@ int main(int argc, char** argv) {
 
 	// measure load time
 	if( debug ) {
-		cerr << "Loaded size: " << (tree.count() + tree6.count()) << endl;
-		cerr << " - IPV4: "  << tree.count() << endl;
-		cerr << " - IPV6: "  << tree6.count() << endl;
+		cerr << "Loaded size: " << (trie.count() + trie6.count()) << endl;
+		cerr << " - IPV4: "  << trie.count() << endl;
+		cerr << " - IPV6: "  << trie6.count() << endl;
 		cerr << "Data load time: " << ROUND((getTime() - time) * 1000, 5) << " ms" << endl;
 	}
 
+	// serve until signalled
+	if( !socketPath.empty() ) {
+		LookupServer server(engine, engine6, &table, &table6);
+		accept_updates(server, engine, engine6, table, table6);
+		if( !server.listen(socketPath) ) {
+			cerr << "Cannot listen on " << socketPath << endl;
+			return EXIT_FAILURE;
+		}
+
+		reloadContext reload;
+		reload.name = sharedName;
+		reload.engineName = engineName;
+		reload.verify = verify;
+		reload.initial = &shared;
+		reload.trie = &trie;
+		reload.trie6 = &trie6;
+		reload.engine = engine;
+		reload.engine6 = engine6;
+		reload.current = NULL;
+		reload.building = false;
+		reload.next = NULL;
+		if( !sharedName.empty() ) {
+			server.onTick(reloadTable, &reload);
+		}
+
+		activeServer = &server;
+		signal(SIGINT, stopServer);
+		signal(SIGTERM, stopServer);
+		const bool served = server.run();
+		activeServer = NULL;
+		finish_reload(&reload);
+		if( reload.current != NULL ) {
+			release_version(reload.current);
+		}
+
+		if( debug ) {
+			cerr << "Served lookups: " << server.served() << endl;
+		}
+		return served ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	// mapping empty
-	if( tree.count() == 0 && tree6.count() == 0 ) {
+	if( trie.count() == 0 && trie6.count() == 0 ) {
 		return EXIT_MAPPING_EMPTY;
 	}
 
+	// matching loop
+	const unsigned int threads = workers > 0 ? workers : 1;
+	vector<LookupHistogram> histograms(debug ? threads : 0), histograms6(debug ? threads : 0);
+	matchContext context;
+	context.engine = engine;
+	context.engine6 = engine6;
+	context.table = &table;
+	context.table6 = &table6;
+	context.histograms = debug ? &histograms[0] : NULL;
+	context.histograms6 = debug ? &histograms6[0] : NULL;
+
+	context.topology = &topology;
+	if( replicated ) {
+		buildReplicas(topology, createEngine4, engineName, trie, context.replicas);
+		buildReplicas(topology, createEngine6, engineName, trie6, context.replicas6);
+	}
+	for(unsigned int w = 0; cacheSize > 0 && w < threads; ++w) {
+		context.caches.push_back(new FlowCache<uint32_t>(cacheSize, cachePolicy));
+		context.caches6.push_back(new FlowCache<uint128>(cacheSize, (FlowCache<uint128>::replacement)cachePolicy));
+	}
+
 	// init matching loop
 	if( debug || simpleDebug ) {
 		time = getTime();
 	}
+	if( debug ) {
+		matchProbe.open();
+		matchProbe.start();
+	}
 
-	// init
-	staticNode* located;
-	char tbuffer[INPUT_BUFFER_SIZE];
-	char ip4[IPV4_BIN_BUFFER_SIZE + 1];
-	char ip6[IPV6_BIN_BUFFER_SIZE + 1];
-
-	unsigned char length;
-	bool ipv4;
-	unsigned int i;
-
-	char obuffer[OUTPUT_BUFFER_SIZE];
-
-	// matching loop
-	while( fgets(tbuffer, INPUT_BUFFER_SIZE, stdin) != NULL ) {
-
-		// fetch input
-		length = strlen(tbuffer);
-		if( length == 0 ) {
-			break;
-		}
-
-		// detect ipv6
-		ipv4 = false;
-		for(i = 1; i < length; ++i) { // 1 intentional, should not start with delimiter
-			if( tbuffer[i] == '.' ) {
-				ipv4 = true;
-				break;
-			} else if( tbuffer[i] == ':' ) {
-				break;
-			}
-		}
-
-		// perform matching
-		if( ipv4 ) {
-			ipv4_char_opt(tbuffer, ip4, length);
-			located = tree.find(ip4);
-		} else {
-			ipv6_char_opt(tbuffer, ip6, length);
-			located = tree6.find(ip6);
-		}
-
-		// set output
-		if( located == NULL || located->isData == false ) {
-			obuffer[buffered++] = '-';
-			obuffer[buffered++] = '\n';
-		} else {
-			for(i=0;i<8;++i) {
-				if( located->as[i] != '\0' ) {
-					obuffer[buffered++] = located->as[i];
-				} else {
-					break;
-				}
-			}
-			obuffer[buffered++] = '\n';
-		}
-
-		mapped++;
-
-		if( buffered >= OUTPUT_BUFFER_SIZE_SAFE ) {
-			obuffer[buffered] = '\0';
-			cout << obuffer;
-			buffered = 0;
-			obuffer[0] = '\0';
-		}
+	InputReader input(stdin);
+	Pipeline pipeline(workers, matchBlock, &context);
+	pipeline.onStart(pinWorker);
+	const bool written = pipeline.run(input, stdout);
+	mapped = pipeline.lines();
+	fflush(stdout);
+	if( !written ) {
+		cerr << "Cannot write output" << endl;
+		return EXIT_FAILURE;
 	}
 
-	// output remaining contents of buffer
-	if( buffered > 0 ) {
-		obuffer[buffered] = '\0';
-		cout << obuffer;
-		buffered = 0;
-		obuffer[0] = '\0';
+	if( debug ) {
+		matchProbe.stop();
 	}
 
 	// measure mapping time
@@ -554,13 +951,61 @@ int main(int argc, char** argv) {
 		cerr << "Mapping 80K: " << ROUND(totalTime*1000*((float)80000 / (float)mapped), 6) << " ms" << endl;
 		cerr << "Mapping 1M: " << ROUND(totalTime*1000*((float)1000000 / (float)mapped), 6) << " ms" << endl;
 		cerr << "Mapping speed: " << fixed << floor(mapped / totalTime) << " entry/sec" << endl;
+
+		if( !context.caches.empty() ) {
+			unsigned long long hits = 0;
+			unsigned long long misses = 0;
+			for(unsigned int w = 0; w < context.caches.size(); ++w) {
+				hits += context.caches[w]->hits() + context.caches6[w]->hits();
+				misses += context.caches[w]->misses() + context.caches6[w]->misses();
+			}
+			const double rate = hits + misses == 0 ? 0 : 100.0 * hits / (hits + misses);
+			cerr << "Flow cache: " << hits << " hits, " << misses << " misses, " << ROUND(rate, 2) << " % hit rate" << endl;
+		}
+
+		if( pages != PAGES_DEFAULT ) {
+			cerr << "Huge page mappings: " << (huge_mapped() >> 20) << " MB" << endl;
+		}
+		if( replicate ) {
+			cerr << "NUMA nodes: " << topology.nodes() << ", replicas: " << context.replicas.size() << endl;
+			for(unsigned int i = 0; i < context.replicas.size(); ++i) {
+				cerr << " - replica " << i << ": node " << topology.id(i) << endl;
+			}
+		}
+
+		matchProbe.report(cerr);
+		for(unsigned int w = 1; w < threads; ++w) {
+			histograms[0].merge(histograms[w]);
+			histograms6[0].merge(histograms6[w]);
+		}
+		if( histograms[0].count() > 0 ) {
+			cerr << "IPv4 lookups (" << engine->name() << ", 1 traced per batch):" << endl;
+			histograms[0].report(cerr);
+		}
+		if( histograms6[0].count() > 0 ) {
+			cerr << "IPv6 lookups (" << engine6->name() << ", 1 traced per batch):" << endl;
+			histograms6[0].report(cerr);
+		}
 	} else if( simpleDebug ) {
 		cerr << fixed << floor(mapped / (getTime() - time)) << endl;
 	}
 
 
-	tree.clear();
-	tree6.clear();
+	for(unsigned int w = 0; w < context.caches.size(); ++w) {
+		delete context.caches[w];
+		delete context.caches6[w];
+	}
+	for(unsigned int n = 0; n < context.replicas.size(); ++n) {
+		delete context.replicas[n];
+		delete context.replicas6[n];
+	}
+
+	if( engine != &trie ) {
+		delete engine;
+	}
+	if( engine6 != &trie6 ) {
+		delete engine6;
+	}
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,376 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "mapping.h"
+#include "parse.h"
+#include "input.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <functional>
+#include <exception>
+#include <system_error>
+#include <unordered_map>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif //WIN32
+
+#define MIN(a,b) (a < b ? a : b)
+
+using std::ifstream;
+using std::thread;
+using std::unordered_map;
+
+
+/**
+ * Prefixes of one newline-aligned part of the file, values index the
+ * distinct AS numbers of the part in order of appearance
+ */
+typedef struct mappingChunk {
+	const char* begin;
+	const char* end;
+	vector<prefixEntry<uint32_t> > prefixes;
+	vector<prefixEntry<uint128> > prefixes6;
+	vector<unsigned int> as;
+	vector<unsigned int> as6;
+	size_t offset;
+	size_t offset6;
+	std::exception_ptr error;
+} mappingChunk;
+
+
+static const char* skip_blanks(const char* p, const char* end) {
+	while( p < end && (*p == ' ' || *p == '\t') ) {
+		p++;
+	}
+	return p;
+}
+
+/**
+ * Parses decimal number, at most limit
+ * @return position after the digits, NULL for no digits or overflow
+ */
+static const char* parse_number(const char* p, const char* end, const uint64_t limit, uint64_t& number) {
+	const char* start = p;
+	number = 0;
+	while( p < end && *p >= '0' && *p <= '9' ) {
+		number = number * 10 + (*p - '0');
+		if( number > limit ) {
+			return NULL;
+		}
+		p++;
+	}
+	return p == start ? NULL : p;
+}
+
+/**
+ * Parses AS number, plain (asplain) or as two 16-bit halves (asdot "1.10")
+ */
+static const char* parse_as(const char* p, const char* end, unsigned int& as) {
+	uint64_t number;
+	p = parse_number(p, end, 0xFFFFFFFF, number);
+	if( p != NULL && p < end && *p == '.' ) {
+		uint64_t low = 0;
+		p = number <= 0xFFFF ? parse_number(p + 1, end, 0xFFFF, low) : NULL;
+		number = (number << 16) | low;
+	}
+	as = number;
+	return p;
+}
+
+/**
+ * Adds one prefix of the chunk, its AS interned into the chunk local list
+ */
+template<typename K>
+static void addPrefix(const char* ip, const size_t ipLength, const unsigned int length, const unsigned int as, vector<prefixEntry<K> >& prefixes, vector<unsigned int>& distinct, unordered_map<unsigned int, unsigned int>& known) {
+	prefixEntry<K> entry = prefixEntry<K>();
+	if( length > key_width(entry.key) || !ip_parse(ip, ipLength, entry.key) ) {
+		return;
+	}
+
+	unordered_map<unsigned int, unsigned int>::iterator found = known.find(as);
+	if( found == known.end() ) {
+		found = known.insert(std::make_pair(as, (unsigned int)distinct.size())).first;
+		distinct.push_back(as);
+	}
+
+	entry.key = key_mask(entry.key, length);
+	entry.length = length;
+	entry.value = found->second;
+	prefixes.push_back(entry);
+}
+
+/**
+ * Parses "prefix/length AS" lines of the chunk; blank lines, comments
+ * ("#" or "//") and malformed lines are skipped, trailing text is ignored
+ */
+static void parse_chunk(mappingChunk* chunk) {
+	unordered_map<unsigned int, unsigned int> known, known6;
+	const char* position = chunk->begin;
+	const char* line;
+	size_t size;
+
+	while( next_line(position, chunk->end, line, size) ) {
+		const char* end = line + size;
+		const char* ip = skip_blanks(line, end);
+		if( ip == end || *ip == '#' || *ip == '/' || *ip == '\r' ) {
+			continue;
+		}
+
+		const char* slash = (const char*)memchr(ip, '/', end - ip);
+		if( slash == NULL ) {
+			continue;
+		}
+
+		uint64_t length;
+		unsigned int as;
+		const char* p = parse_number(slash + 1, end, 128, length);
+		if( p == NULL || p == end || (*p != ' ' && *p != '\t') ) {
+			continue;
+		}
+		p = parse_as(skip_blanks(p, end), end, as);
+		if( p == NULL ) {
+			continue;
+		}
+
+		if( memchr(ip, ':', slash - ip) != NULL ) {
+			addPrefix(ip, slash - ip, length, as, chunk->prefixes6, chunk->as6, known6);
+		} else {
+			addPrefix(ip, slash - ip, length, as, chunk->prefixes, chunk->as, known);
+		}
+	}
+}
+
+/**
+ * Moves the prefixes of the chunk to their place in the result, values
+ * translated to the AS table indexes
+ */
+static void gather_chunk(mappingChunk* chunk, vector<prefixEntry<uint32_t> >* prefixes, vector<prefixEntry<uint128> >* prefixes6) {
+	for(size_t i = 0; i < chunk->prefixes.size(); ++i) {
+		prefixEntry<uint32_t>& entry = (*prefixes)[chunk->offset + i];
+		entry = chunk->prefixes[i];
+		entry.value = chunk->as[entry.value];
+	}
+	for(size_t i = 0; i < chunk->prefixes6.size(); ++i) {
+		prefixEntry<uint128>& entry = (*prefixes6)[chunk->offset6 + i];
+		entry = chunk->prefixes6[i];
+		entry.value = chunk->as6[entry.value];
+	}
+
+	vector<prefixEntry<uint32_t> >().swap(chunk->prefixes);
+	vector<prefixEntry<uint128> >().swap(chunk->prefixes6);
+}
+
+static void run_chunk(const std::function<void(mappingChunk*)>* task, mappingChunk* chunk) {
+	try {
+		(*task)(chunk);
+	} catch(...) {
+		chunk->error = std::current_exception();
+	}
+}
+
+/**
+ * Runs the task on every chunk, the first one on the calling thread; a
+ * chunk whose thread cannot be started is done by the caller as well
+ * @throws the first failure of a chunk once all threads are joined
+ */
+static void run_chunks(vector<mappingChunk>& chunks, const std::function<void(mappingChunk*)>& task) {
+	vector<thread> workers;
+	workers.reserve(chunks.size());
+	for(size_t c = 1; c < chunks.size(); ++c) {
+		try {
+			workers.push_back(thread(run_chunk, &task, &chunks[c]));
+		} catch(const std::system_error&) {
+			run_chunk(&task, &chunks[c]);
+		}
+	}
+	run_chunk(&task, &chunks[0]);
+	for(size_t w = 0; w < workers.size(); ++w) {
+		workers[w].join();
+	}
+
+	for(size_t c = 0; c < chunks.size(); ++c) {
+		if( chunks[c].error ) {
+			std::rethrow_exception(chunks[c].error);
+		}
+	}
+}
+
+/**
+ * Reads the whole file, regular files are mapped
+ * @param mapped set when data points into a mapping of size bytes
+ */
+static bool read_file(const string& filePath, vector<char>& storage, const char*& data, size_t& size, bool& mapped) {
+	mapped = false;
+	data = NULL;
+	size = 0;
+
+#ifdef _WIN32
+	ifstream file(filePath.c_str(), ifstream::in | ifstream::binary);
+	if( !file.is_open() ) {
+		return false;
+	}
+	storage.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+#else
+	const int fd = open(filePath.c_str(), O_RDONLY);
+	if( fd < 0 ) {
+		return false;
+	}
+
+	struct stat info;
+	if( fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 ) {
+		void* memory = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+		if( memory != MAP_FAILED ) {
+			madvise(memory, info.st_size, MADV_WILLNEED);
+			close(fd);
+			data = (const char*)memory;
+			size = info.st_size;
+			mapped = true;
+			return true;
+		}
+	}
+
+	// pipes and files that cannot be mapped
+	char buffer[1 << 16];
+	ssize_t got;
+	while( (got = read(fd, buffer, sizeof(buffer))) != 0 ) {
+		if( got < 0 && errno == EINTR ) {
+			continue;
+		} else if( got < 0 ) {
+			close(fd);
+			return false;
+		}
+		storage.insert(storage.end(), buffer, buffer + got);
+	}
+	close(fd);
+#endif //WIN32
+
+	data = storage.empty() ? NULL : &storage[0];
+	size = storage.size();
+	return true;
+}
+
+/**
+ * Loads data from given file path, parsed on the given number of threads
+ *
+ * The file is split into newline-aligned chunks parsed in parallel. AS
+ * numbers are interned chunk by chunk in file order, so the tables come
+ * out the same whatever the number of threads.
+ * @param filePath
+ * @return false when the file cannot be read
+ */
+bool loadMappingFile(const string filePath, vector<prefixEntry<uint32_t> >& prefixes, vector<prefixEntry<uint128> >& prefixes6, AsTable& table, AsTable& table6, const unsigned int threads) {
+	vector<char> storage;
+	const char* data;
+	size_t size;
+	bool mapped;
+
+	if( !read_file(filePath, storage, data, size, mapped) ) {
+		return false;
+	}
+
+	// small files are not worth the threads
+	size_t count = MIN(threads > 0 ? threads : 1, size / PARSE_CHUNK + 1);
+	vector<mappingChunk> chunks(count);
+	const char* end = data + size;
+	const char* position = data;
+	for(size_t c = 0; c < count; ++c) {
+		const char* boundary = c + 1 == count ? end : data + size * (c + 1) / count;
+		if( boundary < position ) {
+			boundary = position;
+		}
+
+		const char* newline = boundary < end ? (const char*)memchr(boundary, '\n', end - boundary) : NULL;
+		chunks[c].begin = position;
+		chunks[c].end = c + 1 == count || newline == NULL ? end : newline + 1;
+		position = chunks[c].end;
+	}
+
+	try {
+		run_chunks(chunks, parse_chunk);
+	} catch(...) {
+#ifndef _WIN32
+		if( mapped ) {
+			munmap((void*)data, size);
+		}
+#endif //WIN32
+		throw;
+	}
+
+#ifndef _WIN32
+	if( mapped ) {
+		munmap((void*)data, size);
+	}
+#endif //WIN32
+
+	// intern in file order, distinct AS numbers are few
+	size_t total = prefixes.size();
+	size_t total6 = prefixes6.size();
+	for(size_t c = 0; c < count; ++c) {
+		for(size_t i = 0; i < chunks[c].as.size(); ++i) {
+			chunks[c].as[i] = table.intern(chunks[c].as[i]);
+		}
+		for(size_t i = 0; i < chunks[c].as6.size(); ++i) {
+			chunks[c].as6[i] = table6.intern(chunks[c].as6[i]);
+		}
+
+		chunks[c].offset = total;
+		chunks[c].offset6 = total6;
+		total += chunks[c].prefixes.size();
+		total6 += chunks[c].prefixes6.size();
+	}
+
+	prefixes.resize(total);
+	prefixes6.resize(total6);
+	run_chunks(chunks, std::bind(gather_chunk, std::placeholders::_1, &prefixes, &prefixes6));
+
+	return true;
+}
+
+static void build_trie6(PatriciaTrie<uint128>* trie6, const vector<prefixEntry<uint128> >* prefixes6, const unsigned int threads, std::exception_ptr* error) {
+	try {
+		trie6->buildParallel(*prefixes6, threads);
+	} catch(...) {
+		*error = std::current_exception();
+	}
+}
+
+/**
+ * Builds the tries of both families at once, each on the given number of threads
+ */
+void build_tries(PatriciaTrie<uint32_t>& trie, const vector<prefixEntry<uint32_t> >& prefixes, PatriciaTrie<uint128>& trie6, const vector<prefixEntry<uint128> >& prefixes6, const unsigned int threads) {
+	std::exception_ptr error6;
+	std::thread family6;
+	try {
+		family6 = std::thread(build_trie6, &trie6, &prefixes6, threads, &error6);
+	} catch(const std::system_error&) {
+		build_trie6(&trie6, &prefixes6, threads, &error6);
+	}
+
+	try {
+		trie.buildParallel(prefixes, threads);
+	} catch(...) {
+		if( family6.joinable() ) {
+			family6.join();
+		}
+		throw;
+	}
+
+	if( family6.joinable() ) {
+		family6.join();
+	}
+	if( error6 ) {
+		std::rethrow_exception(error6);
+	}
+}
@@ -0,0 +1,33 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef MAPPING_H
+#define	MAPPING_H
+
+#include <string>
+#include <vector>
+#include "address.h"
+#include "astable.h"
+#include "patricia.h"
+
+using std::string;
+using std::vector;
+
+/** Least bytes of mapping file per parsing thread */
+const size_t PARSE_CHUNK = 1 << 20;
+
+/**
+ * Reads a mapping file ("prefix/length AS" per line) into unsorted prefix
+ * lists of both families, AS numbers are interned into the tables
+ */
+bool loadMappingFile(const string filePath, vector<prefixEntry<uint32_t> >& prefixes, vector<prefixEntry<uint128> >& prefixes6, AsTable& table, AsTable& table6, const unsigned int threads);
+
+void build_tries(PatriciaTrie<uint32_t>& trie, const vector<prefixEntry<uint32_t> >& prefixes, PatriciaTrie<uint128>& trie6, const vector<prefixEntry<uint128> >& prefixes6, const unsigned int threads);
+
+#endif	/* MAPPING_H */
@@ -0,0 +1,428 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "parse.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARSE_SIMD 1
+#include <immintrin.h>
+#else
+#define PARSE_SIMD 0
+#endif
+
+#define IPV4_LAYOUTS 81
+#define PAGE_SIZE_MIN 4096
+
+
+bool ipv4_parse_scalar(const char* text, const size_t length, uint32_t& key) {
+	uint32_t result = 0;
+	unsigned int octet = 0;
+	unsigned int digits = 0;
+	unsigned int dots = 0;
+
+	for(size_t i = 0; i < length; ++i) {
+		const char c = text[i];
+
+		if( c >= '0' && c <= '9' ) {
+			octet = octet * 10 + (c - '0');
+			if( ++digits > 3 ) {
+				return false;
+			}
+		} else if( c == '.' ) {
+			if( digits == 0 || dots == 3 || octet > 255 ) {
+				return false;
+			}
+			result = (result << 8) | octet;
+			octet = 0;
+			digits = 0;
+			dots++;
+		} else if( is_address_end(c) ) {
+			break;
+		} else {
+			return false;
+		}
+	}
+
+	if( digits == 0 || dots != 3 || octet > 255 ) {
+		return false;
+	}
+
+	key = (result << 8) | octet;
+	return true;
+}
+
+static unsigned int ipv4_batch_scalar(const char* const* texts, const size_t* lengths, uint32_t* keys, bool* valid, const unsigned int count) {
+	unsigned int parsed = 0;
+	for(unsigned int i = 0; i < count; ++i) {
+		valid[i] = ipv4_parse_scalar(texts[i], lengths[i], keys[i]);
+		parsed += valid[i];
+	}
+	return parsed;
+}
+
+
+#if PARSE_SIMD
+
+/*
+ * Vector parser
+ *
+ * The dots and the end of the address give one of 81 layouts of 1-3 digit
+ * octets. Every layout has a shuffle that moves the digits of each octet
+ * right-aligned into its own 32-bit lane, so two multiply-adds with weights
+ * 100/10/1 produce all four octets at once.
+ */
+
+static unsigned char ipv4Shuffle[IPV4_LAYOUTS][16];
+
+static bool buildShuffles() {
+	for(unsigned int layout = 0; layout < IPV4_LAYOUTS; ++layout) {
+		unsigned int lengths[4] = {layout / 27 + 1, layout / 9 % 3 + 1, layout / 3 % 3 + 1, layout % 3 + 1};
+		unsigned int start = 0;
+
+		for(unsigned int octet = 0; octet < 4; ++octet) {
+			unsigned char* lane = ipv4Shuffle[layout] + octet * 4;
+			lane[0] = 0x80;
+
+			for(unsigned int j = 0; j < 3; ++j) {
+				lane[j + 1] = j < 3 - lengths[octet] ? 0x80 : start + j - (3 - lengths[octet]);
+			}
+
+			start += lengths[octet] + 1;
+		}
+	}
+
+	return true;
+}
+
+static const bool shufflesReady = buildShuffles();
+
+/**
+ * Layout index from dot positions and address length, -1 when malformed
+ */
+static inline int ipv4_layout(unsigned int dots, const unsigned int length) {
+	if( __builtin_popcount(dots) != 3 ) {
+		return -1;
+	}
+
+	const unsigned int first = __builtin_ctz(dots);
+	dots &= dots - 1;
+	const unsigned int second = __builtin_ctz(dots);
+	dots &= dots - 1;
+	const unsigned int third = __builtin_ctz(dots);
+
+	const unsigned int l1 = first - 1;
+	const unsigned int l2 = second - first - 2;
+	const unsigned int l3 = third - second - 2;
+	const unsigned int l4 = length - third - 2;
+
+	// unsigned wrap turns empty octets into huge values too
+	if( (l1 > 2) | (l2 > 2) | (l3 > 2) | (l4 > 2) ) {
+		return -1;
+	}
+
+	return l1 * 27 + l2 * 9 + l3 * 3 + l4;
+}
+
+/**
+ * Source of a 16 byte load, copied aside when it could cross into an unmapped page
+ */
+static inline const char* ipv4_source(const char* text, const size_t length, char* local) {
+	if( ((uintptr_t)text & (PAGE_SIZE_MIN - 1)) <= PAGE_SIZE_MIN - 16 ) {
+		return text;
+	}
+
+	memset(local, 0, 16);
+	memcpy(local, text, length < 16 ? length : 16);
+	return local;
+}
+
+/**
+ * Address length (chars up to the first one not being digit or dot), 16 when too long
+ */
+__attribute__((target("sse4.1")))
+static inline unsigned int ipv4_extent(const __m128i isDigit, const __m128i isDot, const size_t length) {
+	unsigned int accepted = _mm_movemask_epi8(_mm_or_si128(isDigit, isDot));
+	if( length < 16 ) {
+		accepted &= (1u << length) - 1;
+	}
+	return __builtin_ctz(~accepted);
+}
+
+__attribute__((target("sse4.1")))
+static bool ipv4_parse_sse(const char* text, const size_t length, uint32_t& key) {
+	char local[16];
+	const __m128i v = _mm_loadu_si128((const __m128i*)ipv4_source(text, length, local));
+	const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+	const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+	const __m128i isDot = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+
+	const unsigned int extent = ipv4_extent(isDigit, isDot, length);
+	if( extent > 15 || (extent < length && !is_address_end(text[extent])) ) {
+		return false;
+	}
+
+	const int layout = ipv4_layout(_mm_movemask_epi8(isDot) & ((1u << extent) - 1), extent);
+	if( layout < 0 ) {
+		return false;
+	}
+
+	const __m128i digits = _mm_shuffle_epi8(d, _mm_loadu_si128((const __m128i*)ipv4Shuffle[layout]));
+	const __m128i pairs = _mm_maddubs_epi16(digits, _mm_set1_epi32(0x010A6400));
+	const __m128i octets = _mm_madd_epi16(pairs, _mm_set1_epi16(1));
+
+	if( _mm_movemask_epi8(_mm_cmpgt_epi32(octets, _mm_set1_epi32(255))) != 0 ) {
+		return false;
+	}
+
+	const __m128i packed = _mm_shuffle_epi8(octets, _mm_setr_epi8(12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+	key = (uint32_t)_mm_cvtsi128_si32(packed);
+	return true;
+}
+
+__attribute__((target("sse4.1")))
+static unsigned int ipv4_batch_sse(const char* const* texts, const size_t* lengths, uint32_t* keys, bool* valid, const unsigned int count) {
+	unsigned int parsed = 0;
+	for(unsigned int i = 0; i < count; ++i) {
+		valid[i] = ipv4_parse_sse(texts[i], lengths[i], keys[i]);
+		parsed += valid[i];
+	}
+	return parsed;
+}
+
+/**
+ * Two addresses per step, one in each 128-bit lane
+ */
+__attribute__((target("avx2")))
+static unsigned int ipv4_batch_avx2(const char* const* texts, const size_t* lengths, uint32_t* keys, bool* valid, const unsigned int count) {
+	unsigned int parsed = 0;
+	unsigned int i = 0;
+	char local[2][16];
+
+	for(; i + 2 <= count; i += 2) {
+		const __m128i first = _mm_loadu_si128((const __m128i*)ipv4_source(texts[i], lengths[i], local[0]));
+		const __m128i second = _mm_loadu_si128((const __m128i*)ipv4_source(texts[i + 1], lengths[i + 1], local[1]));
+		const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(first), second, 1);
+
+		const __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+		const __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+		const __m256i isDot = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'));
+
+		const unsigned int dots = _mm256_movemask_epi8(isDot);
+		const unsigned int accepted = _mm256_movemask_epi8(_mm256_or_si256(isDigit, isDot));
+		int layout[2];
+
+		for(unsigned int lane = 0; lane < 2; ++lane) {
+			unsigned int mask = (accepted >> (lane * 16)) & 0xFFFF;
+			if( lengths[i + lane] < 16 ) {
+				mask &= (1u << lengths[i + lane]) - 1;
+			}
+
+			const unsigned int extent = __builtin_ctz(~mask);
+			const bool ended = extent >= lengths[i + lane] || is_address_end(texts[i + lane][extent]);
+			layout[lane] = extent > 15 || !ended ? -1 : ipv4_layout((dots >> (lane * 16)) & ((1u << extent) - 1), extent);
+		}
+
+		const __m256i shuffle = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)ipv4Shuffle[layout[0] < 0 ? 0 : layout[0]])),
+			_mm_loadu_si128((const __m128i*)ipv4Shuffle[layout[1] < 0 ? 0 : layout[1]]), 1);
+
+		const __m256i digits = _mm256_shuffle_epi8(d, shuffle);
+		const __m256i pairs = _mm256_maddubs_epi16(digits, _mm256_set1_epi32(0x010A6400));
+		const __m256i octets = _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+		const unsigned int overflow = _mm256_movemask_epi8(_mm256_cmpgt_epi32(octets, _mm256_set1_epi32(255)));
+
+		const __m256i packed = _mm256_shuffle_epi8(octets, _mm256_setr_epi8(
+			12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+
+		valid[i] = layout[0] >= 0 && (overflow & 0xFFFF) == 0;
+		valid[i + 1] = layout[1] >= 0 && (overflow >> 16) == 0;
+		keys[i] = (uint32_t)_mm256_extract_epi32(packed, 0);
+		keys[i + 1] = (uint32_t)_mm256_extract_epi32(packed, 4);
+		parsed += valid[i] + valid[i + 1];
+	}
+
+	for(; i < count; ++i) {
+		valid[i] = ipv4_parse_sse(texts[i], lengths[i], keys[i]);
+		parsed += valid[i];
+	}
+
+	return parsed;
+}
+
+#endif //PARSE_SIMD
+
+
+/*
+ * IPv6 parser
+ *
+ * Single pass over the text per RFC 4291 section 2.2: 1-4 digit hex
+ * groups, at most one "::", optional trailing dotted quad and a "%zone"
+ * suffix, which is ignored. Hex digits are decoded by table lookup.
+ */
+
+static unsigned char hexValue[256];
+
+static bool buildHexValues() {
+	memset(hexValue, 0xFF, sizeof(hexValue));
+	for(unsigned int c = 0; c < 10; ++c) {
+		hexValue['0' + c] = c;
+	}
+	for(unsigned int c = 0; c < 6; ++c) {
+		hexValue['a' + c] = 10 + c;
+		hexValue['A' + c] = 10 + c;
+	}
+	return true;
+}
+
+static const bool hexValuesReady = buildHexValues();
+
+bool ipv6_parse(const char* text, const size_t length, uint128& key) {
+	const unsigned char* c = (const unsigned char*)text;
+	unsigned int groups[8];
+	unsigned int count = 0;
+	int gap = -1;
+	size_t i = 0;
+
+	// leading double colon
+	if( length >= 2 && c[0] == ':' && c[1] == ':' ) {
+		gap = 0;
+		i = 2;
+	}
+
+	while( i < length && count < 8 ) {
+		const size_t start = i;
+		unsigned int value = 0;
+		unsigned int nibble;
+
+		while( i < length && (nibble = hexValue[c[i]]) < 16 ) {
+			value = (value << 4) | nibble;
+			i++;
+		}
+
+		// embedded IPv4 takes the last two groups
+		if( i < length && c[i] == '.' ) {
+			uint32_t ipv4;
+
+			while( i < length && (c[i] == '.' || (c[i] >= '0' && c[i] <= '9')) ) {
+				i++;
+			}
+
+			if( count > 6 || !ipv4_parse_scalar(text + start, i - start, ipv4) ) {
+				return false;
+			}
+
+			groups[count++] = ipv4 >> 16;
+			groups[count++] = ipv4 & 0xFFFF;
+			break;
+		}
+
+		// nothing may follow "::", an empty group anywhere else is an error
+		if( i == start ) {
+			if( gap == (int)count ) {
+				break;
+			}
+			return false;
+		}
+
+		if( i - start > 4 ) {
+			return false;
+		}
+
+		groups[count++] = value;
+
+		if( i >= length || c[i] != ':' ) {
+			break;
+		}
+
+		// single colon continues, double colon marks the gap
+		i++;
+		if( i < length && c[i] == ':' ) {
+			if( gap >= 0 ) {
+				return false;
+			}
+			gap = count;
+			i++;
+		} else if( i >= length || hexValue[c[i]] >= 16 ) {
+			return false;
+		}
+	}
+
+	// whatever follows must end the address
+	if( i < length && !is_address_end(text[i]) ) {
+		return false;
+	}
+
+	if( (gap < 0 && count != 8) || (gap >= 0 && count > 7) ) {
+		return false;
+	}
+
+	// expand double colon
+	unsigned int full[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	const unsigned int head = gap < 0 ? count : gap;
+	for(unsigned int g = 0; g < head; ++g) {
+		full[g] = groups[g];
+	}
+	for(unsigned int g = head; g < count; ++g) {
+		full[8 - count + g] = groups[g];
+	}
+
+	key.high = ((uint64_t)full[0] << 48) | ((uint64_t)full[1] << 32) | ((uint64_t)full[2] << 16) | full[3];
+	key.low = ((uint64_t)full[4] << 48) | ((uint64_t)full[5] << 32) | ((uint64_t)full[6] << 16) | full[7];
+	return true;
+}
+
+
+/*
+ * Runtime dispatch - picked once by the CPU features
+ */
+
+typedef struct ipv4Parser {
+	const char* name;
+	bool (*single)(const char*, const size_t, uint32_t&);
+	unsigned int (*batch)(const char* const*, const size_t*, uint32_t*, bool*, const unsigned int);
+} ipv4Parser;
+
+static ipv4Parser selectIpv4Parser() {
+	ipv4Parser parser = {"scalar", ipv4_parse_scalar, ipv4_batch_scalar};
+
+#if PARSE_SIMD
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports("avx2") ) {
+		parser.name = "avx2";
+		parser.single = ipv4_parse_sse;
+		parser.batch = ipv4_batch_avx2;
+	} else if( __builtin_cpu_supports("sse4.1") ) {
+		parser.name = "sse4.1";
+		parser.single = ipv4_parse_sse;
+		parser.batch = ipv4_batch_sse;
+	}
+#endif
+
+	return parser;
+}
+
+static const ipv4Parser ipv4Selected = selectIpv4Parser();
+
+
+bool ipv4_parse(const char* text, const size_t length, uint32_t& key) {
+	return ipv4Selected.single(text, length, key);
+}
+
+/**
+ * Parses count addresses, returns number of valid ones
+ */
+unsigned int ipv4_parse_batch(const char* const* texts, const size_t* lengths, uint32_t* keys, bool* valid, const unsigned int count) {
+	return ipv4Selected.batch(texts, lengths, keys, valid, count);
+}
+
+const char* ipv4_parser_name() {
+	return ipv4Selected.name;
+}
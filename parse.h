@@ -0,0 +1,64 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef PARSE_H
+#define	PARSE_H
+
+#include <stddef.h>
+#include "address.h"
+
+/*
+ * Address text parsers producing integer keys
+ *
+ * An address takes the whole text or ends at a space, tab, '\r', '\n' or
+ * a '%' starting a zone; anything else after it ("10.1.2.3x") makes the
+ * address invalid. Invalid addresses make the parsers return false.
+ */
+
+/**
+ * Character that may follow an address
+ */
+inline bool is_address_end(const char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '%';
+}
+
+bool ipv4_parse(const char* text, const size_t length, uint32_t& key);
+unsigned int ipv4_parse_batch(const char* const* texts, const size_t* lengths, uint32_t* keys, bool* valid, const unsigned int count);
+bool ipv4_parse_scalar(const char* text, const size_t length, uint32_t& key);
+const char* ipv4_parser_name();
+
+bool ipv6_parse(const char* text, const size_t length, uint128& key);
+
+/**
+ * Parses address of the key family
+ */
+inline bool ip_parse(const char* text, const size_t length, uint32_t& key) {
+	return ipv4_parse(text, length, key);
+}
+
+inline bool ip_parse(const char* text, const size_t length, uint128& key) {
+	return ipv6_parse(text, length, key);
+}
+
+/**
+ * Detects IPv4 address by a dot appearing before any colon
+ */
+inline bool is_ipv4(const char* ip, const size_t length) {
+	for(size_t i = 1; i < length; ++i) { // 1 intentional, should not start with delimiter
+		if( ip[i] == '.' ) {
+			return true;
+		} else if( ip[i] == ':' ) {
+			return false;
+		}
+	}
+
+	return false;
+}
+
+#endif	/* PARSE_H */
@@ -0,0 +1,618 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef PATRICIA_H
+#define	PATRICIA_H
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include "address.h"
+#include "engine.h"
+#include "hugepage.h"
+
+using std::vector;
+
+/**
+ * Path-compressed binary trie over integer keys (uint32_t or uint128)
+ *
+ * Every node keeps its whole prefix masked to its length, so a node is
+ * matched by a single xor + count-leading-zeros and the child is picked
+ * by the next key bit. Nodes live in one array and point to each other
+ * by index, the root (length 0) is always the first one. Having no
+ * pointers, the array can also be attached read-only from a mapped
+ * snapshot and queried in place.
+ */
+template<typename K>
+class PatriciaTrie : public LookupEngine<K> {
+
+	public:
+		static const unsigned int NONE = 0xFFFFFFFF;
+
+		typedef struct patriciaNode {
+			K prefix;
+			unsigned int children[2];
+			unsigned int value;
+			unsigned char length;
+		} patriciaNode;
+
+		PatriciaTrie();
+
+		void build(const vector<prefixEntry<K> >& prefixes);
+		void buildSorted(const vector<prefixEntry<K> >& sorted);
+		void buildParallel(const vector<prefixEntry<K> >& prefixes, const unsigned int threads);
+		void insert(const K& key, const unsigned char length, const unsigned int value);
+		unsigned int find(const K& key) const;
+		void findBatch(const K* keys, unsigned int* results, const unsigned int count) const;
+		unsigned int trace(const K& key, unsigned int& depth) const;
+		void clear();
+
+		bool attach(const patriciaNode* nodes, const unsigned int count, const unsigned int prefixes, const unsigned int values);
+		void prefixes(vector<prefixEntry<K> >& out) const;
+		const patriciaNode* data() const;
+
+		const char* name() const;
+		unsigned int count() const;
+		unsigned int nodeCount() const;
+		unsigned int size() const;
+
+	private:
+		unsigned int addNode(const K& key, const unsigned char length, const unsigned int value);
+		void graft(const unsigned int node);
+
+		static void buildPartitions(const vector<prefixEntry<K> >* partitioned, const vector<unsigned int>* bounds, vector<PatriciaTrie<K>*>* subtries, std::atomic<unsigned int>* next, std::exception_ptr* error);
+
+		vector<patriciaNode, HugeAllocator<patriciaNode> > nodes;
+		const patriciaNode* base;
+		unsigned int baseCount;
+		unsigned int _size;
+
+};
+
+
+template<typename K>
+PatriciaTrie<K>::PatriciaTrie() {
+	this->clear();
+}
+
+template<typename K>
+void PatriciaTrie<K>::clear() {
+	K zero = K();
+
+	this->nodes.clear();
+	this->_size = 0;
+	this->addNode(zero, 0, 0);
+}
+
+/**
+ * Uses external node array (e.g. mapped snapshot), which must outlive the trie;
+ * the trie is read-only until clear() or build()
+ *
+ * The array is checked first: children must lie inside it and be longer
+ * than their parent, so no lookup can loop or leave it, and values must
+ * index the AS table of the given size.
+ * @return false for a corrupt array, the trie is left empty
+ */
+template<typename K>
+bool PatriciaTrie<K>::attach(const patriciaNode* nodes, const unsigned int count, const unsigned int prefixes, const unsigned int values) {
+	const unsigned int width = key_width(K());
+	bool valid = count > 0 && nodes[0].length == 0;
+	for(unsigned int i = 0; valid && i < count; ++i) {
+		const patriciaNode& n = nodes[i];
+		valid = n.length <= width && n.value < values;
+		for(unsigned int c = 0; valid && c < 2; ++c) {
+			const unsigned int child = n.children[c];
+			valid = child == NONE || (child < count && nodes[child].length > n.length);
+		}
+	}
+
+	if( !valid ) {
+		this->clear();
+		return false;
+	}
+
+	this->nodes.clear();
+	this->base = nodes;
+	this->baseCount = count;
+	this->_size = prefixes;
+	return true;
+}
+
+template<typename K>
+void PatriciaTrie<K>::prefixes(vector<prefixEntry<K> >& out) const {
+	for(unsigned int i = 0; i < this->baseCount; ++i) {
+		if( this->base[i].value != 0 ) {
+			prefixEntry<K> entry;
+			entry.key = this->base[i].prefix;
+			entry.length = this->base[i].length;
+			entry.value = this->base[i].value;
+			out.push_back(entry);
+		}
+	}
+}
+
+template<typename K>
+inline const typename PatriciaTrie<K>::patriciaNode* PatriciaTrie<K>::data() const {
+	return this->base;
+}
+
+/**
+ * Sorts the prefixes once and builds the trie in a single pass
+ */
+template<typename K>
+void PatriciaTrie<K>::build(const vector<prefixEntry<K> >& prefixes) {
+	vector<prefixEntry<K> > sorted;
+	sorted.reserve(prefixes.size());
+
+	for(unsigned int i = 0; i < prefixes.size(); ++i) {
+		if( prefixes[i].value != 0 ) {
+			sorted.push_back(prefixes[i]);
+			sorted.back().key = key_mask(prefixes[i].key, prefixes[i].length);
+		}
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), prefix_order<K>);
+	this->buildSorted(sorted);
+}
+
+/**
+ * Builds the trie from masked prefixes ordered by prefix_order, of equal
+ * prefixes the last one wins
+ *
+ * Only the path to the previous prefix can still change, it is kept on a
+ * stack; nodes popped from it are final. Every prefix is pushed and popped
+ * at most once, so the build is linear.
+ */
+template<typename K>
+void PatriciaTrie<K>::buildSorted(const vector<prefixEntry<K> >& sorted) {
+	vector<unsigned int> path;
+
+	this->clear();
+	this->nodes.reserve(sorted.size() * 2 + 1);
+	path.push_back(0);
+
+	for(unsigned int i = 0; i < sorted.size(); ++i) {
+		const K& key = sorted[i].key;
+		const unsigned char length = sorted[i].length;
+		const unsigned int value = sorted[i].value;
+
+		// leave nodes that are not a prefix of key, the root always is
+		while( true ) {
+			const patriciaNode& top = this->nodes[path.back()];
+			if( top.length <= length && key_common(key, top.prefix) >= top.length ) {
+				break;
+			}
+			path.pop_back();
+		}
+
+		const unsigned int current = path.back();
+
+		if( this->nodes[current].length == length ) {
+			if( this->nodes[current].value == 0 && value != 0 ) {
+				this->_size++;
+			}
+			this->nodes[current].value = value;
+			continue;
+		}
+
+		const unsigned int bit = key_bit(key, this->nodes[current].length);
+		const unsigned int child = this->nodes[current].children[bit];
+
+		// free slot - insert value leaf
+		if( child == NONE ) {
+			const unsigned int leaf = this->addNode(key, length, value);
+			this->nodes[current].children[bit] = leaf;
+			path.push_back(leaf);
+			this->_size++;
+			continue;
+		}
+
+		// child was just popped, so it diverges from key - split the edge
+		unsigned int common = key_common(key, this->nodes[child].prefix);
+		if( common > length ) {
+			common = length;
+		}
+
+		const unsigned int split = this->addNode(key, common, common == length ? value : 0);
+		this->nodes[split].children[key_bit(this->nodes[child].prefix, common)] = child;
+		this->nodes[current].children[bit] = split;
+		path.push_back(split);
+		this->_size++;
+
+		if( common < length ) {
+			const unsigned int leaf = this->addNode(key, length, value);
+			this->nodes[split].children[key_bit(key, common)] = leaf;
+			path.push_back(leaf);
+		}
+	}
+}
+
+/**
+ * Builds the trie on several threads, the same one build() would
+ *
+ * Prefixes are partitioned by their leading bits (8 for IPv4, 16 for
+ * IPv6); each partition is sorted and built as an independent subtrie.
+ * The prefixes shorter than that form the top level, built serially, the
+ * subtries are then copied behind it and grafted in. All nodes of a
+ * subtrie share the leading bits, so grafting only ever splits edges of
+ * the top level.
+ */
+template<typename K>
+void PatriciaTrie<K>::buildParallel(const vector<prefixEntry<K> >& prefixes, const unsigned int threads) {
+	const unsigned int bits = key_width(K()) <= 32 ? 8 : 16;
+	const unsigned int partitions = 1 << bits;
+
+	// stable counting partition, of equal prefixes the last one still wins
+	vector<unsigned int> bounds(partitions + 2, 0);
+	vector<prefixEntry<K> > top;
+	for(unsigned int i = 0; i < prefixes.size(); ++i) {
+		if( prefixes[i].value != 0 && prefixes[i].length >= bits ) {
+			bounds[key_extract(prefixes[i].key, 0, bits) + 2]++;
+		}
+	}
+	for(unsigned int p = 2; p < bounds.size(); ++p) {
+		bounds[p] += bounds[p - 1];
+	}
+
+	vector<prefixEntry<K> > partitioned(bounds.back());
+	for(unsigned int i = 0; i < prefixes.size(); ++i) {
+		if( prefixes[i].value == 0 ) {
+			continue;
+		}
+
+		prefixEntry<K> entry = prefixes[i];
+		entry.key = key_mask(entry.key, entry.length);
+		if( entry.length >= bits ) {
+			partitioned[bounds[key_extract(entry.key, 0, bits) + 1]++] = entry;
+		} else {
+			top.push_back(entry);
+		}
+	}
+
+	// partition p now spans bounds[p] to bounds[p + 1]
+	vector<PatriciaTrie<K>*> subtries(partitions, NULL);
+	std::atomic<unsigned int> next(0);
+	vector<std::exception_ptr> errors(threads > 0 ? threads : 1);
+	vector<std::thread> workers;
+	workers.reserve(errors.size());
+	for(unsigned int t = 1; t < errors.size(); ++t) {
+		try {
+			workers.push_back(std::thread(buildPartitions, &partitioned, &bounds, &subtries, &next, &errors[t]));
+		} catch(const std::system_error&) {
+			// the threads already running take the rest
+			break;
+		}
+	}
+	buildPartitions(&partitioned, &bounds, &subtries, &next, &errors[0]);
+	for(unsigned int t = 0; t < workers.size(); ++t) {
+		workers[t].join();
+	}
+
+	for(unsigned int t = 0; t < errors.size(); ++t) {
+		if( errors[t] ) {
+			for(unsigned int p = 0; p < partitions; ++p) {
+				delete subtries[p];
+			}
+			std::rethrow_exception(errors[t]);
+		}
+	}
+
+	std::stable_sort(top.begin(), top.end(), prefix_order<K>);
+	this->buildSorted(top);
+
+	// subtrie nodes without their roots, children shifted by the offset
+	unsigned int total = this->nodes.size();
+	vector<unsigned int> offsets(partitions, 0);
+	for(unsigned int p = 0; p < partitions; ++p) {
+		if( subtries[p] != NULL ) {
+			offsets[p] = total - 1;
+			total += subtries[p]->nodes.size() - 1;
+		}
+	}
+
+	this->nodes.resize(total);
+	for(unsigned int p = 0; p < partitions; ++p) {
+		if( subtries[p] == NULL ) {
+			continue;
+		}
+
+		const PatriciaTrie<K>& subtrie = *subtries[p];
+		for(unsigned int i = 1; i < subtrie.nodes.size(); ++i) {
+			patriciaNode n = subtrie.nodes[i];
+			for(unsigned int c = 0; c < 2; ++c) {
+				if( n.children[c] != NONE ) {
+					n.children[c] += offsets[p];
+				}
+			}
+			this->nodes[offsets[p] + i] = n;
+		}
+		this->_size += subtrie._size;
+	}
+	this->base = &this->nodes[0];
+	this->baseCount = this->nodes.size();
+
+	// all keys of a partition share its bits, so its root has one child
+	for(unsigned int p = 0; p < partitions; ++p) {
+		if( subtries[p] == NULL ) {
+			continue;
+		}
+
+		const patriciaNode& root = subtries[p]->nodes[0];
+		const unsigned int child = root.children[0] != NONE ? root.children[0] : root.children[1];
+		this->graft(child + offsets[p]);
+		delete subtries[p];
+	}
+}
+
+/**
+ * Worker of buildParallel, takes partitions until none are left; a
+ * failure stops the worker and is left in error
+ */
+template<typename K>
+void PatriciaTrie<K>::buildPartitions(const vector<prefixEntry<K> >* partitioned, const vector<unsigned int>* bounds, vector<PatriciaTrie<K>*>* subtries, std::atomic<unsigned int>* next, std::exception_ptr* error) {
+	try {
+		vector<prefixEntry<K> > sorted;
+
+		while( true ) {
+			const unsigned int p = next->fetch_add(1);
+			if( p >= subtries->size() ) {
+				return;
+			}
+
+			const unsigned int begin = (*bounds)[p];
+			const unsigned int end = (*bounds)[p + 1];
+			if( begin == end ) {
+				continue;
+			}
+
+			sorted.assign(partitioned->begin() + begin, partitioned->begin() + end);
+			std::stable_sort(sorted.begin(), sorted.end(), prefix_order<K>);
+
+			(*subtries)[p] = new PatriciaTrie<K>();
+			(*subtries)[p]->buildSorted(sorted);
+		}
+	} catch(...) {
+		*error = std::current_exception();
+	}
+}
+
+/**
+ * Links in a node whose subtree lies entirely below the top level, like
+ * insert() does with a new leaf
+ */
+template<typename K>
+void PatriciaTrie<K>::graft(const unsigned int node) {
+	const K key = this->nodes[node].prefix;
+	const unsigned char length = this->nodes[node].length;
+	unsigned int current = 0;
+
+	while( true ) {
+		const unsigned int bit = key_bit(key, this->nodes[current].length);
+		const unsigned int child = this->nodes[current].children[bit];
+
+		if( child == NONE ) {
+			this->nodes[current].children[bit] = node;
+			return;
+		}
+
+		const unsigned int common = key_common(key, this->nodes[child].prefix);
+		if( common >= this->nodes[child].length ) {
+			current = child;
+			continue;
+		}
+
+		// the node diverges from child above both of them
+		const unsigned int split = this->addNode(key, common < length ? common : length, 0);
+		this->nodes[split].children[key_bit(this->nodes[child].prefix, common)] = child;
+		this->nodes[split].children[key_bit(key, common)] = node;
+		this->nodes[current].children[bit] = split;
+		return;
+	}
+}
+
+template<typename K>
+inline const char* PatriciaTrie<K>::name() const {
+	return "patricia";
+}
+
+template<typename K>
+inline unsigned int PatriciaTrie<K>::count() const {
+	return this->_size;
+}
+
+template<typename K>
+inline unsigned int PatriciaTrie<K>::nodeCount() const {
+	return this->baseCount;
+}
+
+template<typename K>
+inline unsigned int PatriciaTrie<K>::size() const {
+	return this->baseCount * sizeof(patriciaNode);
+}
+
+template<typename K>
+unsigned int PatriciaTrie<K>::addNode(const K& key, const unsigned char length, const unsigned int value) {
+	patriciaNode n;
+	memset(&n, 0, sizeof(n));
+	n.prefix = key_mask(key, length);
+	n.children[0] = NONE;
+	n.children[1] = NONE;
+	n.value = value;
+	n.length = length;
+
+	this->nodes.push_back(n);
+	this->base = &this->nodes[0];
+	this->baseCount = this->nodes.size();
+	return this->nodes.size() - 1;
+}
+
+template<typename K>
+void PatriciaTrie<K>::insert(const K& data, const unsigned char length, const unsigned int value) {
+	const K key = key_mask(data, length);
+	unsigned int current = 0;
+
+	// invariant: current node is a prefix of key and not longer than it
+	while( true ) {
+		if( this->nodes[current].length == length ) {
+			if( this->nodes[current].value == 0 && value != 0 ) {
+				this->_size++;
+			}
+			this->nodes[current].value = value;
+			return;
+		}
+
+		const unsigned int bit = key_bit(key, this->nodes[current].length);
+		const unsigned int child = this->nodes[current].children[bit];
+
+		// free slot - insert value leaf
+		if( child == NONE ) {
+			const unsigned int leaf = this->addNode(key, length, value);
+			this->nodes[current].children[bit] = leaf;
+			this->_size++;
+			return;
+		}
+
+		unsigned int common = key_common(key, this->nodes[child].prefix);
+		if( common > length ) {
+			common = length;
+		}
+
+		// child is a prefix of key - descend
+		if( common >= this->nodes[child].length ) {
+			current = child;
+			continue;
+		}
+
+		// split the edge between current and child
+		const unsigned int split = this->addNode(key, common, common == length ? value : 0);
+		this->nodes[split].children[key_bit(this->nodes[child].prefix, common)] = child;
+		this->nodes[current].children[bit] = split;
+
+		if( common == length ) {
+			this->_size++;
+		} else {
+			const unsigned int leaf = this->addNode(key, length, value);
+			this->nodes[split].children[key_bit(key, common)] = leaf;
+			this->_size++;
+		}
+		return;
+	}
+}
+
+template<typename K>
+inline unsigned int PatriciaTrie<K>::find(const K& key) const {
+	const patriciaNode* nodes = this->base;
+	const unsigned int width = key_width(key);
+	unsigned int best = 0;
+	unsigned int current = 0;
+
+	do {
+		const patriciaNode& n = nodes[current];
+
+		if( key_clz(key_xor(key, n.prefix)) < n.length ) {
+			break;
+		}
+
+		if( n.value != 0 ) {
+			best = n.value;
+		}
+
+		if( n.length == width ) {
+			break;
+		}
+
+		current = n.children[key_bit(key, n.length)];
+	} while( current != NONE );
+
+	return best;
+}
+
+template<typename K>
+unsigned int PatriciaTrie<K>::trace(const K& key, unsigned int& depth) const {
+	const unsigned int width = key_width(key);
+	unsigned int visited = 0;
+	unsigned int current = 0;
+
+	depth = 0;
+	do {
+		const patriciaNode& n = this->base[current];
+		visited++;
+
+		if( key_clz(key_xor(key, n.prefix)) < n.length ) {
+			break;
+		}
+
+		depth = n.length;
+		if( n.length == width ) {
+			break;
+		}
+
+		current = n.children[key_bit(key, n.length)];
+	} while( current != NONE );
+
+	return visited;
+}
+
+template<typename K>
+void PatriciaTrie<K>::findBatch(const K* keys, unsigned int* results, const unsigned int count) const {
+	const patriciaNode* nodes = this->base;
+	const unsigned int width = key_width(K());
+	unsigned int current[BATCH_GROUP];
+
+	for(unsigned int group = 0; group < count; group += BATCH_GROUP) {
+		const unsigned int size = count - group < BATCH_GROUP ? count - group : BATCH_GROUP;
+		const K* key = keys + group;
+		unsigned int* best = results + group;
+		unsigned int active = size;
+
+		for(unsigned int i = 0; i < size; ++i) {
+			current[i] = 0;
+			best[i] = 0;
+		}
+
+		// one step of every lookup per round, next nodes are prefetched meanwhile
+		while( active > 0 ) {
+			active = 0;
+
+			for(unsigned int i = 0; i < size; ++i) {
+				if( current[i] == NONE ) {
+					continue;
+				}
+
+				const patriciaNode& n = nodes[current[i]];
+
+				if( key_clz(key_xor(key[i], n.prefix)) < n.length ) {
+					current[i] = NONE;
+					continue;
+				}
+
+				if( n.value != 0 ) {
+					best[i] = n.value;
+				}
+
+				if( n.length == width ) {
+					current[i] = NONE;
+					continue;
+				}
+
+				current[i] = n.children[key_bit(key[i], n.length)];
+				if( current[i] != NONE ) {
+					PREFETCH(&nodes[current[i]]);
+					active++;
+				}
+			}
+		}
+	}
+}
+
+#endif	/* PATRICIA_H */
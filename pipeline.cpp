@@ -0,0 +1,255 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "pipeline.h"
+#include <thread>
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#endif //WIN32
+
+using std::thread;
+using std::unique_lock;
+using std::mutex;
+
+const unsigned int Pipeline::WRITE_BATCH;
+
+
+/**
+ * Writes all given buffers with as few system calls as possible
+ */
+static bool write_blocks(FILE* output, vector<char>* blocks, const unsigned int count) {
+#ifdef _WIN32
+	for(unsigned int i = 0; i < count; ++i) {
+		if( !blocks[i].empty() && fwrite(&blocks[i][0], 1, blocks[i].size(), output) != blocks[i].size() ) {
+			return false;
+		}
+	}
+	return true;
+#else
+	struct iovec parts[Pipeline::WRITE_BATCH];
+	unsigned int used = 0;
+
+	for(unsigned int i = 0; i < count && used < Pipeline::WRITE_BATCH; ++i) {
+		if( !blocks[i].empty() ) {
+			parts[used].iov_base = &blocks[i][0];
+			parts[used].iov_len = blocks[i].size();
+			used++;
+		}
+	}
+
+	const int fd = fileno(output);
+	struct iovec* part = parts;
+
+	while( used > 0 ) {
+		const ssize_t written = writev(fd, part, used);
+		if( written < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			return false;
+		}
+
+		// skip what got written, resume inside a partially written buffer
+		size_t rest = written;
+		while( used > 0 && rest >= part->iov_len ) {
+			rest -= part->iov_len;
+			part++;
+			used--;
+		}
+		if( used > 0 ) {
+			part->iov_base = (char*)part->iov_base + rest;
+			part->iov_len -= rest;
+		}
+	}
+	return true;
+#endif //WIN32
+}
+
+
+Pipeline::Pipeline(const unsigned int workers, blockHandler handler, void* context) {
+	this->workers = workers == 0 ? 1 : workers;
+	this->handler = handler;
+	this->start = NULL;
+	this->context = context;
+	this->nextWork = 0;
+	this->_lines = 0;
+	this->writeFailed = false;
+}
+
+void Pipeline::onStart(startHandler handler) {
+	this->start = handler;
+}
+
+/**
+ * Processes the whole input, stops reading once the output fails
+ * @return false when the output could not be written
+ */
+bool Pipeline::run(InputReader& input, FILE* output) {
+	const char* data;
+	size_t length;
+
+	this->_lines = 0;
+	this->writeFailed = false;
+
+	// output bypasses stdio buffering from here on
+	fflush(output);
+
+	// single worker, no threads needed
+	if( this->workers == 1 ) {
+		vector<char> storage, result;
+
+		if( this->start != NULL ) {
+			this->start(this->context, 0);
+		}
+
+		while( input.nextBlock(storage, data, length) ) {
+			result.clear();
+			this->_lines += this->handler(data, length, result, this->context, 0);
+			if( !write_blocks(output, &result, 1) ) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// ring of blocks in flight
+	this->slots.clear();
+	this->slots.resize(this->workers * 4);
+	for(unsigned int i = 0; i < this->slots.size(); ++i) {
+		this->slots[i].state = SLOT_EMPTY;
+	}
+	this->nextWork = 0;
+
+	vector<thread> pool;
+	for(unsigned int i = 0; i < this->workers; ++i) {
+		pool.push_back(thread(&Pipeline::work, this, i));
+	}
+	thread writer(&Pipeline::write, this, output);
+
+	unsigned long long sequence = 0;
+	bool more = true;
+
+	while( more ) {
+		pipelineSlot& slot = this->slots[sequence % this->slots.size()];
+
+		unique_lock<mutex> guard(this->lock);
+		while( slot.state != SLOT_EMPTY ) {
+			this->changed.wait(guard);
+		}
+		guard.unlock();
+
+		// slot storage is not touched by anyone else while empty
+		more = input.nextBlock(slot.storage, data, length);
+
+		guard.lock();
+		more = more && !this->writeFailed;
+		if( more ) {
+			slot.data = data;
+			slot.length = length;
+			slot.state = SLOT_READ;
+		} else {
+			slot.state = SLOT_END;
+		}
+
+		sequence++;
+		this->changed.notify_all();
+	}
+
+	for(unsigned int i = 0; i < pool.size(); ++i) {
+		pool[i].join();
+	}
+	writer.join();
+
+	return !this->writeFailed;
+}
+
+/**
+ * Worker - takes blocks in sequence order, end marker stays for the others
+ */
+void Pipeline::work(const unsigned int worker) {
+	vector<char> output;
+
+	if( this->start != NULL ) {
+		this->start(this->context, worker);
+	}
+
+	while( true ) {
+		unique_lock<mutex> guard(this->lock);
+
+		pipelineSlot* slot = &this->slots[this->nextWork % this->slots.size()];
+		while( slot->state != SLOT_READ && slot->state != SLOT_END ) {
+			this->changed.wait(guard);
+			slot = &this->slots[this->nextWork % this->slots.size()];
+		}
+
+		if( slot->state == SLOT_END ) {
+			return;
+		}
+
+		slot->state = SLOT_TAKEN;
+		this->nextWork++;
+		guard.unlock();
+
+		output.clear();
+		const unsigned int processed = this->handler(slot->data, slot->length, output, this->context, worker);
+
+		guard.lock();
+		slot->output.swap(output);
+		slot->lines = processed;
+		slot->state = SLOT_DONE;
+		this->changed.notify_all();
+	}
+}
+
+/**
+ * Writer - outputs finished blocks in input order, consecutive finished
+ * blocks go out with a single writev()
+ */
+void Pipeline::write(FILE* output) {
+	unsigned long long sequence = 0;
+	vector<char> results[WRITE_BATCH];
+
+	while( true ) {
+		unique_lock<mutex> guard(this->lock);
+		pipelineSlot* slot = &this->slots[sequence % this->slots.size()];
+		while( slot->state != SLOT_DONE && slot->state != SLOT_END ) {
+			this->changed.wait(guard);
+		}
+
+		unsigned int count = 0;
+		while( count < WRITE_BATCH && slot->state == SLOT_DONE ) {
+			results[count++].swap(slot->output);
+			this->_lines += slot->lines;
+			slot->state = SLOT_EMPTY;
+			slot = &this->slots[++sequence % this->slots.size()];
+		}
+
+		const bool end = count == 0;
+		const bool failed = this->writeFailed;
+		this->changed.notify_all();
+		guard.unlock();
+
+		if( end ) {
+			return;
+		}
+
+		// after a failure blocks are only drained until the reader stops
+		if( !failed && !write_blocks(output, results, count) ) {
+			guard.lock();
+			this->writeFailed = true;
+			guard.unlock();
+		}
+		for(unsigned int i = 0; i < count; ++i) {
+			results[i].clear();
+		}
+	}
+}
@@ -0,0 +1,90 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef PIPELINE_H
+#define	PIPELINE_H
+
+#include <stdio.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "input.h"
+
+using std::vector;
+
+/**
+ * Reader -> workers -> writer pipeline over newline-aligned input blocks
+ *
+ * The calling thread takes blocks from the input and hands them out to
+ * the workers,
+ * which transform them with the block handler. A writer thread outputs
+ * the results strictly in input order, straight to the output descriptor.
+ * With a single worker everything runs on the calling thread.
+ */
+class Pipeline {
+
+	public:
+		static const unsigned int WRITE_BATCH = 16;
+
+		/**
+		 * Transforms one block of whole lines, returns number of lines processed
+		 * @param worker index of the calling worker, for per-thread state in context
+		 */
+		typedef unsigned int (*blockHandler)(const char* data, const size_t length, vector<char>& output, void* context, const unsigned int worker);
+
+		/**
+		 * Runs on each worker thread before its first block, e.g. to pin it
+		 */
+		typedef void (*startHandler)(void* context, const unsigned int worker);
+
+		Pipeline(const unsigned int workers, blockHandler handler, void* context);
+
+		void onStart(startHandler handler);
+
+		bool run(InputReader& input, FILE* output);
+		unsigned int lines() const;
+
+	private:
+		enum slotState { SLOT_EMPTY, SLOT_READ, SLOT_TAKEN, SLOT_DONE, SLOT_END };
+
+		typedef struct pipelineSlot {
+			vector<char> storage;
+			const char* data;
+			size_t length;
+			vector<char> output;
+			unsigned int lines;
+			slotState state;
+		} pipelineSlot;
+
+		void work(const unsigned int worker);
+		void write(FILE* output);
+
+		unsigned int workers;
+		blockHandler handler;
+		startHandler start;
+		void* context;
+
+		vector<pipelineSlot> slots;
+		unsigned long long nextWork;
+		unsigned int _lines;
+		bool writeFailed;
+
+		std::mutex lock;
+		std::condition_variable changed;
+
+};
+
+/**
+ * Lines processed by the last run()
+ */
+inline unsigned int Pipeline::lines() const {
+	return this->_lines;
+}
+
+#endif	/* PIPELINE_H */
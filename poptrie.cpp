@@ -0,0 +1,241 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "poptrie.h"
+#include <algorithm>
+#include <exception>
+
+using std::exception;
+
+const unsigned int Poptrie::DIRECT_BITS;
+const unsigned int Poptrie::STRIDE;
+const uint32_t Poptrie::DIRECT_LEAF;
+
+/**
+ * Orders by key, ancestors before their descendants
+ */
+static bool prefixOrder(const prefixEntry<uint128>& a, const prefixEntry<uint128>& b) {
+	return a.key < b.key || (a.key == b.key && a.length < b.length);
+}
+
+static bool shorterPrefix(const prefixEntry<uint128>& a, const prefixEntry<uint128>& b) {
+	return a.length < b.length;
+}
+
+
+Poptrie::Poptrie() {
+	this->clear();
+}
+
+void Poptrie::clear() {
+	this->direct.assign(1 << DIRECT_BITS, DIRECT_LEAF);
+	this->nodes.clear();
+	this->leaves.assign(1, 0);
+}
+
+void Poptrie::build(const vector<prefixEntry<uint128> >& prefixes) {
+	vector<prefixEntry<uint128> > sorted;
+	vector<prefixEntry<uint128> > shorter;
+
+	this->clear();
+
+	for(unsigned int i = 0; i < prefixes.size(); ++i) {
+		if( prefixes[i].value == 0 ) {
+			continue;
+		}
+
+		if( prefixes[i].value & DIRECT_LEAF ) {
+			throw exception();
+		}
+
+		prefixEntry<uint128> entry = prefixes[i];
+		entry.key = key_mask(entry.key, entry.length);
+
+		if( entry.length <= DIRECT_BITS ) {
+			shorter.push_back(entry);
+		} else {
+			sorted.push_back(entry);
+		}
+	}
+
+	// paint short prefixes into direct table, longer ones last
+	vector<unsigned int> values(1 << DIRECT_BITS, 0);
+	std::stable_sort(shorter.begin(), shorter.end(), shorterPrefix);
+	for(unsigned int i = 0; i < shorter.size(); ++i) {
+		const uint32_t first = key_extract(shorter[i].key, 0, DIRECT_BITS);
+		const uint32_t last = first + (1u << (DIRECT_BITS - shorter[i].length));
+		for(uint32_t e = first; e < last; ++e) {
+			values[e] = shorter[i].value;
+		}
+	}
+
+	// one subtree per group of longer prefixes sharing the top bits
+	std::sort(sorted.begin(), sorted.end(), prefixOrder);
+
+	unsigned int first = 0;
+	for(uint32_t e = 0; e < (1u << DIRECT_BITS); ++e) {
+		unsigned int last = first;
+		while( last < sorted.size() && key_extract(sorted[last].key, 0, DIRECT_BITS) == e ) {
+			last++;
+		}
+
+		if( last == first ) {
+			this->direct[e] = DIRECT_LEAF | values[e];
+			continue;
+		}
+
+		const unsigned int index = this->nodes.size();
+		this->nodes.resize(index + 1);
+		this->direct[e] = index;
+		this->compile(index, sorted, first, last, DIRECT_BITS, values[e]);
+
+		first = last;
+	}
+}
+
+/**
+ * Fills node from prefixes [first, last) that all extend past pos bits
+ * @param inherited value of the longest prefix covering the whole node
+ */
+void Poptrie::compile(const unsigned int index, const vector<prefixEntry<uint128> >& sorted, const unsigned int first, const unsigned int last, const unsigned int pos, const unsigned int inherited) {
+	const unsigned int slots = 1 << STRIDE;
+	unsigned int values[1 << STRIDE];
+	unsigned int childFirst[1 << STRIDE];
+	unsigned int childLast[1 << STRIDE];
+	vector<prefixEntry<uint128> > ending;
+
+	for(unsigned int s = 0; s < slots; ++s) {
+		values[s] = inherited;
+		childFirst[s] = 0;
+		childLast[s] = 0;
+	}
+
+	// split into prefixes ending in this stride and the ones going deeper
+	for(unsigned int i = first; i < last; ++i) {
+		// already accounted for in the inherited value
+		if( sorted[i].length <= pos ) {
+			continue;
+		}
+
+		if( sorted[i].length <= pos + STRIDE ) {
+			ending.push_back(sorted[i]);
+			continue;
+		}
+
+		const uint32_t s = key_extract(sorted[i].key, pos, STRIDE);
+		if( childFirst[s] == childLast[s] ) {
+			childFirst[s] = i;
+		}
+		childLast[s] = i + 1;
+	}
+
+	std::stable_sort(ending.begin(), ending.end(), shorterPrefix);
+	for(unsigned int i = 0; i < ending.size(); ++i) {
+		const uint32_t from = key_extract(ending[i].key, pos, STRIDE);
+		const uint32_t to = from + (1u << (pos + STRIDE - ending[i].length));
+		for(uint32_t s = from; s < to; ++s) {
+			values[s] = ending[i].value;
+		}
+	}
+
+	// bitmaps and compressed leaves
+	poptrieNode n;
+	n.vector = 0;
+	n.leafvec = 0;
+	n.base0 = this->leaves.size();
+
+	bool previousLeaf = false;
+	unsigned int previous = 0;
+	unsigned int children = 0;
+
+	for(unsigned int s = 0; s < slots; ++s) {
+		if( childFirst[s] != childLast[s] ) {
+			n.vector |= 1ull << s;
+			children++;
+		} else if( !previousLeaf || values[s] != previous ) {
+			n.leafvec |= 1ull << s;
+			this->leaves.push_back(values[s]);
+			previousLeaf = true;
+			previous = values[s];
+		}
+	}
+
+	n.base1 = this->nodes.size();
+	this->nodes.resize(n.base1 + children);
+	this->nodes[index] = n;
+
+	unsigned int child = n.base1;
+	for(unsigned int s = 0; s < slots; ++s) {
+		if( childFirst[s] == childLast[s] ) {
+			continue;
+		}
+
+		this->compile(child++, sorted, childFirst[s], childLast[s], pos + STRIDE, values[s]);
+	}
+}
+
+void Poptrie::findBatch(const uint128* keys, unsigned int* results, const unsigned int count) const {
+	const uint32_t DONE = 0xFFFFFFFF;
+	uint32_t index[BATCH_GROUP];
+	unsigned int pos[BATCH_GROUP];
+
+	for(unsigned int group = 0; group < count; group += BATCH_GROUP) {
+		const unsigned int size = count - group < BATCH_GROUP ? count - group : BATCH_GROUP;
+		const uint128* key = keys + group;
+		unsigned int* result = results + group;
+		unsigned int active = 0;
+
+		for(unsigned int i = 0; i < size; ++i) {
+			PREFETCH(&this->direct[key[i].high >> (64 - DIRECT_BITS)]);
+		}
+
+		for(unsigned int i = 0; i < size; ++i) {
+			const uint32_t entry = this->direct[key[i].high >> (64 - DIRECT_BITS)];
+			if( entry & DIRECT_LEAF ) {
+				result[i] = entry & ~DIRECT_LEAF;
+				index[i] = DONE;
+			} else {
+				index[i] = entry;
+				pos[i] = DIRECT_BITS;
+				PREFETCH(&this->nodes[entry]);
+				active++;
+			}
+		}
+
+		// one stride of every lookup per round
+		while( active > 0 ) {
+			active = 0;
+
+			for(unsigned int i = 0; i < size; ++i) {
+				if( index[i] == DONE ) {
+					continue;
+				}
+
+				const poptrieNode& n = this->nodes[index[i]];
+				const uint64_t bit = 1ull << key_extract(key[i], pos[i], STRIDE);
+				const uint64_t below = bit | (bit - 1);
+
+				if( (n.vector & bit) == 0 ) {
+					result[i] = this->leaves[n.base0 + __builtin_popcountll(n.leafvec & below) - 1];
+					index[i] = DONE;
+					continue;
+				}
+
+				index[i] = n.base1 + __builtin_popcountll(n.vector & below) - 1;
+				pos[i] += STRIDE;
+				PREFETCH(&this->nodes[index[i]]);
+				active++;
+			}
+		}
+	}
+}
+
+unsigned int Poptrie::size() const {
+	return this->direct.size() * sizeof(uint32_t) + this->nodes.size() * sizeof(poptrieNode) + this->leaves.size() * sizeof(unsigned int);
+}
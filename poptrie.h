@@ -0,0 +1,119 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef POPTRIE_H
+#define	POPTRIE_H
+
+#include <vector>
+#include "engine.h"
+#include "hugepage.h"
+
+using std::vector;
+
+/**
+ * Poptrie multibit trie for IPv6
+ *
+ * The first 16 bits index a direct-pointing table, the rest is walked in
+ * 6-bit strides. Each internal node has a 64-bit child bitmap and a 64-bit
+ * leaf bitmap; children and leaves of one node are stored contiguously and
+ * addressed by popcount of the bitmap below the stride value. Runs of equal
+ * leaves are compressed to a single entry. Direct table entries without
+ * a subtree hold the value itself.
+ */
+class Poptrie : public LookupEngine<uint128> {
+
+	public:
+		static const unsigned int DIRECT_BITS = 16;
+		static const unsigned int STRIDE = 6;
+		static const uint32_t DIRECT_LEAF = 0x80000000;
+
+		typedef struct poptrieNode {
+			uint64_t vector;
+			uint64_t leafvec;
+			uint32_t base0;
+			uint32_t base1;
+		} poptrieNode;
+
+		Poptrie();
+
+		void build(const vector<prefixEntry<uint128> >& prefixes);
+		unsigned int find(const uint128& key) const;
+		void findBatch(const uint128* keys, unsigned int* results, const unsigned int count) const;
+		unsigned int trace(const uint128& key, unsigned int& depth) const;
+		void clear();
+
+		const char* name() const;
+		unsigned int size() const;
+
+	private:
+		void compile(const unsigned int index, const vector<prefixEntry<uint128> >& sorted, const unsigned int first, const unsigned int last, const unsigned int pos, const unsigned int inherited);
+
+		vector<uint32_t, HugeAllocator<uint32_t> > direct;
+		vector<poptrieNode, HugeAllocator<poptrieNode> > nodes;
+		vector<unsigned int, HugeAllocator<unsigned int> > leaves;
+
+};
+
+inline unsigned int Poptrie::find(const uint128& key) const {
+	const uint32_t entry = this->direct[key.high >> (64 - DIRECT_BITS)];
+
+	if( entry & DIRECT_LEAF ) {
+		return entry & ~DIRECT_LEAF;
+	}
+
+	unsigned int index = entry;
+	unsigned int pos = DIRECT_BITS;
+
+	while( true ) {
+		const poptrieNode& n = this->nodes[index];
+		const uint64_t bit = 1ull << key_extract(key, pos, STRIDE);
+		const uint64_t below = bit | (bit - 1);
+
+		if( (n.vector & bit) == 0 ) {
+			return this->leaves[n.base0 + __builtin_popcountll(n.leafvec & below) - 1];
+		}
+
+		index = n.base1 + __builtin_popcountll(n.vector & below) - 1;
+		pos += STRIDE;
+	}
+}
+
+/**
+ * Direct table entry, internal nodes and the leaf read
+ */
+inline unsigned int Poptrie::trace(const uint128& key, unsigned int& depth) const {
+	const uint32_t entry = this->direct[key.high >> (64 - DIRECT_BITS)];
+	unsigned int visited = 1;
+
+	depth = DIRECT_BITS;
+	if( entry & DIRECT_LEAF ) {
+		return visited;
+	}
+
+	unsigned int index = entry;
+	while( true ) {
+		const poptrieNode& n = this->nodes[index];
+		const uint64_t bit = 1ull << key_extract(key, depth, STRIDE);
+		const uint64_t below = bit | (bit - 1);
+
+		visited++;
+		depth += STRIDE;
+		if( (n.vector & bit) == 0 ) {
+			return visited + 1;
+		}
+
+		index = n.base1 + __builtin_popcountll(n.vector & below) - 1;
+	}
+}
+
+inline const char* Poptrie::name() const {
+	return "poptrie";
+}
+
+#endif	/* POPTRIE_H */
@@ -0,0 +1,198 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "probe.h"
+#include <cstring>
+#include "tree.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using std::endl;
+
+const unsigned int LookupHistogram::BUCKETS;
+
+static const char* COUNTER_NAMES[Probe::COUNTERS] = { "cycles", "LLC misses", "dTLB misses", "branch misses" };
+
+
+uint64_t read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (uint64_t)(getTime() * 1e9);
+#endif
+}
+
+#ifdef __linux__
+/**
+ * Opens one disabled counter of this process and the threads it starts later
+ */
+static int open_counter(const uint32_t type, const uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+
+Probe::Probe(const char* label) {
+	this->label = label;
+	this->elapsed = 0;
+	this->started = 0;
+	this->ticks = 0;
+	this->ticksStarted = 0;
+
+	for(unsigned int c = 0; c < COUNTERS; ++c) {
+		this->fds[c] = -1;
+		this->values[c] = 0;
+	}
+}
+
+void Probe::open() {
+#ifdef __linux__
+	this->fds[CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	this->fds[LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	this->fds[DTLB_MISSES] = open_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+		| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	this->fds[BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+}
+
+Probe::~Probe() {
+#ifdef __linux__
+	for(unsigned int c = 0; c < COUNTERS; ++c) {
+		if( this->fds[c] >= 0 ) {
+			close(this->fds[c]);
+		}
+	}
+#endif
+}
+
+/**
+ * Counters unsupported by the CPU or forbidden by perf_event_paranoid are skipped
+ */
+bool Probe::counting() const {
+	for(unsigned int c = 0; c < COUNTERS; ++c) {
+		if( this->fds[c] >= 0 ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Probe::start() {
+#ifdef __linux__
+	for(unsigned int c = 0; c < COUNTERS; ++c) {
+		if( this->fds[c] >= 0 ) {
+			ioctl(this->fds[c], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+
+	this->started = getTime();
+	this->ticksStarted = read_ticks();
+}
+
+void Probe::stop() {
+	this->ticks += read_ticks() - this->ticksStarted;
+	this->elapsed += getTime() - this->started;
+
+#ifdef __linux__
+	for(unsigned int c = 0; c < COUNTERS; ++c) {
+		uint64_t value;
+		if( this->fds[c] >= 0 ) {
+			ioctl(this->fds[c], PERF_EVENT_IOC_DISABLE, 0);
+			if( read(this->fds[c], &value, sizeof(value)) == (ssize_t)sizeof(value) ) {
+				this->values[c] = value;
+			}
+		}
+	}
+#endif
+}
+
+void Probe::report(ostream& out) const {
+	out << "Phase " << this->label << ": " << this->elapsed * 1000 << " ms, " << this->ticks << " ticks";
+
+	for(unsigned int c = 0; c < COUNTERS; ++c) {
+		if( this->fds[c] >= 0 ) {
+			out << ", " << this->values[c] << " " << COUNTER_NAMES[c];
+		}
+	}
+	if( !this->counting() ) {
+		out << " (no perf counters)";
+	}
+
+	out << endl;
+}
+
+
+LookupHistogram::LookupHistogram() {
+	this->visits.assign(BUCKETS, 0);
+	this->depths.assign(BUCKETS, 0);
+	this->total = 0;
+}
+
+void LookupHistogram::merge(const LookupHistogram& other) {
+	for(unsigned int b = 0; b < BUCKETS; ++b) {
+		this->visits[b] += other.visits[b];
+		this->depths[b] += other.depths[b];
+	}
+	this->total += other.total;
+}
+
+void LookupHistogram::report(ostream& out) const {
+	this->reportOne(out, "Nodes visited", this->visits);
+	this->reportOne(out, "Depth (bits)", this->depths);
+}
+
+/**
+ * Mean, median and p99, then the non-empty buckets with their share
+ */
+void LookupHistogram::reportOne(ostream& out, const char* label, const vector<unsigned long long>& buckets) const {
+	if( this->total == 0 ) {
+		return;
+	}
+
+	unsigned long long seen = 0;
+	unsigned long long sum = 0;
+	unsigned int median = 0;
+	unsigned int p99 = 0;
+
+	for(unsigned int b = 0; b < BUCKETS; ++b) {
+		sum += buckets[b] * b;
+		if( seen < (this->total + 1) / 2 && seen + buckets[b] >= (this->total + 1) / 2 ) {
+			median = b;
+		}
+		if( seen < this->total - this->total / 100 && seen + buckets[b] >= this->total - this->total / 100 ) {
+			p99 = b;
+		}
+		seen += buckets[b];
+	}
+
+	out << label << ": mean " << (double)sum / this->total << ", median " << median << ", p99 " << p99 << endl;
+	for(unsigned int b = 0; b < BUCKETS; ++b) {
+		if( buckets[b] != 0 ) {
+			out << "\t" << b << "\t" << buckets[b] << "\t" << 100.0 * buckets[b] / this->total << " %" << endl;
+		}
+	}
+}
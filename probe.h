@@ -0,0 +1,102 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef PROBE_H
+#define	PROBE_H
+
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+
+using std::vector;
+using std::ostream;
+
+/**
+ * Time stamp counter on x86, monotonic nanoseconds elsewhere
+ */
+uint64_t read_ticks();
+
+/**
+ * Phase timer of the debug mode
+ *
+ * Measures monotonic wall time and time stamp counter ticks between
+ * start() and stop(). After open(), when the kernel allows it, also
+ * counts cycles, last level cache, dTLB read and branch misses of the
+ * process, threads started later included. Repeated start/stop pairs
+ * accumulate.
+ */
+class Probe {
+
+	public:
+		enum counter { CYCLES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, COUNTERS };
+
+		Probe(const char* label);
+		virtual ~Probe();
+
+		void open();
+		void start();
+		void stop();
+
+		double seconds() const;
+		bool counting() const;
+		void report(ostream& out) const;
+
+	private:
+		const char* label;
+		int fds[COUNTERS];
+		uint64_t values[COUNTERS];
+
+		double elapsed;
+		double started;
+		uint64_t ticks;
+		uint64_t ticksStarted;
+
+};
+
+inline double Probe::seconds() const {
+	return this->elapsed;
+}
+
+
+/**
+ * Distribution of nodes visited and depth reached per lookup, one per
+ * thread; merge() before report()
+ */
+class LookupHistogram {
+
+	public:
+		static const unsigned int BUCKETS = 130;
+
+		LookupHistogram();
+
+		void add(const unsigned int visited, const unsigned int depth);
+		void merge(const LookupHistogram& other);
+		unsigned long long count() const;
+		void report(ostream& out) const;
+
+	private:
+		void reportOne(ostream& out, const char* label, const vector<unsigned long long>& buckets) const;
+
+		vector<unsigned long long> visits;
+		vector<unsigned long long> depths;
+		unsigned long long total;
+
+};
+
+inline void LookupHistogram::add(const unsigned int visited, const unsigned int depth) {
+	this->visits[visited < BUCKETS ? visited : BUCKETS - 1]++;
+	this->depths[depth < BUCKETS ? depth : BUCKETS - 1]++;
+	this->total++;
+}
+
+inline unsigned long long LookupHistogram::count() const {
+	return this->total;
+}
+
+#endif	/* PROBE_H */
@@ -0,0 +1,525 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "server.h"
+#include <cstring>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif //WIN32
+
+const uint32_t LookupServer::MAX_COUNT;
+const size_t LookupServer::MAX_PENDING;
+const size_t LookupServer::READ_SIZE;
+const unsigned int LookupServer::MAX_EVENTS;
+const int LookupServer::TICK_MS;
+
+#ifndef _WIN32
+/**
+ * Receives or sends exactly length bytes on a blocking socket
+ */
+static bool transfer(const int fd, char* data, size_t length, const bool reading) {
+	while( length > 0 ) {
+		const ssize_t done = reading ? ::recv(fd, data, length, 0) : ::send(fd, data, length, MSG_NOSIGNAL);
+		if( done < 0 && errno == EINTR ) {
+			continue;
+		} else if( done <= 0 ) {
+			return false;
+		}
+		data += done;
+		length -= done;
+	}
+	return true;
+}
+
+static bool make_address(const string& path, struct sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if( path.size() >= sizeof(address.sun_path) ) {
+		return false;
+	}
+	memcpy(address.sun_path, path.c_str(), path.size());
+	return true;
+}
+#endif
+
+
+LookupServer::LookupServer(const LookupEngine<uint32_t>* engine, const LookupEngine<uint128>* engine6, const AsTable* table, const AsTable* table6) {
+	this->use(engine, engine6, table, table6);
+	this->acceptUpdates(NULL, NULL, NULL, NULL);
+	this->tick = NULL;
+	this->tickContext = NULL;
+	this->listener = -1;
+	this->epoll = -1;
+	this->wakeup[0] = -1;
+	this->wakeup[1] = -1;
+	this->_served = 0;
+}
+
+LookupServer::~LookupServer() {
+#ifndef _WIN32
+	for(unsigned int i = 0; i < this->connections.size(); ++i) {
+		::close(this->connections[i]->fd);
+		delete this->connections[i];
+	}
+	if( this->listener >= 0 ) {
+		::close(this->listener);
+		unlink(this->path.c_str());
+	}
+	if( this->epoll >= 0 ) {
+		::close(this->epoll);
+	}
+	if( this->wakeup[0] >= 0 ) {
+		::close(this->wakeup[0]);
+		::close(this->wakeup[1]);
+	}
+#endif
+}
+
+void LookupServer::use(const LookupEngine<uint32_t>* engine, const LookupEngine<uint128>* engine6, const AsTable* table, const AsTable* table6) {
+	this->engine = engine;
+	this->engine6 = engine6;
+	this->table = table;
+	this->table6 = table6;
+}
+
+void LookupServer::onTick(tickHandler handler, void* context) {
+	this->tick = handler;
+	this->tickContext = context;
+}
+
+/**
+ * Takes route updates into the live tables, the same the lookups go to;
+ * NULL refuses updates of the family
+ */
+void LookupServer::acceptUpdates(LiveTable<uint32_t>* live, LiveTable<uint128>* live6, AsTable* table, AsTable* table6) {
+	this->live = live;
+	this->live6 = live6;
+	this->liveTable = table;
+	this->liveTable6 = table6;
+}
+
+/**
+ * Removes a socket file left by a dead server
+ * @return false when path is taken by another file or a running server
+ */
+static bool remove_stale_socket(const string& path, const struct sockaddr_un& address) {
+	struct stat info;
+	if( lstat(path.c_str(), &info) != 0 ) {
+		return errno == ENOENT;
+	}
+	if( !S_ISSOCK(info.st_mode) ) {
+		return false;
+	}
+
+	const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if( probe < 0 ) {
+		return false;
+	}
+	const bool refused = connect(probe, (const struct sockaddr*)&address, sizeof(address)) != 0 && errno == ECONNREFUSED;
+	::close(probe);
+
+	return refused && unlink(path.c_str()) == 0;
+}
+
+/**
+ * Binds the socket, a stale socket file left by a dead server is replaced
+ */
+bool LookupServer::listen(const string& path) {
+#ifdef _WIN32
+	return false;
+#else
+	struct sockaddr_un address;
+	struct epoll_event event;
+
+	if( !make_address(path, address) ) {
+		return false;
+	}
+
+	this->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if( this->listener < 0 ) {
+		return false;
+	}
+
+	if( !remove_stale_socket(path, address) || bind(this->listener, (struct sockaddr*)&address, sizeof(address)) != 0 || ::listen(this->listener, SOMAXCONN) != 0 ) {
+		::close(this->listener);
+		this->listener = -1;
+		return false;
+	}
+	this->path = path;
+
+	this->epoll = epoll_create1(EPOLL_CLOEXEC);
+	if( this->epoll < 0 || pipe2(this->wakeup, O_NONBLOCK | O_CLOEXEC) != 0 ) {
+		return false;
+	}
+
+	// listener and the stop pipe carry no connection
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if( epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->listener, &event) != 0 ) {
+		return false;
+	}
+	event.data.ptr = this->wakeup;
+	return epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->wakeup[0], &event) == 0;
+#endif
+}
+
+/**
+ * Async-signal-safe, makes run() return
+ */
+void LookupServer::stop() {
+#ifndef _WIN32
+	const char byte = 0;
+	if( this->wakeup[1] >= 0 && ::write(this->wakeup[1], &byte, 1) < 0 ) {
+		return;
+	}
+#endif
+}
+
+/**
+ * Serves clients until stop()
+ * @return false on failure of the event loop itself
+ */
+bool LookupServer::run() {
+#ifdef _WIN32
+	return false;
+#else
+	struct epoll_event events[MAX_EVENTS];
+
+	while( true ) {
+		const int ready = epoll_wait(this->epoll, events, MAX_EVENTS, this->tick != NULL ? TICK_MS : -1);
+		if( this->tick != NULL ) {
+			this->tick(*this, this->tickContext);
+		}
+		if( ready < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			return false;
+		}
+
+		for(int i = 0; i < ready; ++i) {
+			if( events[i].data.ptr == this->wakeup ) {
+				return true;
+			} else if( events[i].data.ptr == NULL ) {
+				this->accept();
+				continue;
+			}
+
+			connection* c = (connection*)events[i].data.ptr;
+			bool alive = true;
+
+			// a hung up client cannot take answers any more
+			if( events[i].events & (EPOLLERR | EPOLLHUP) ) {
+				alive = false;
+			}
+			if( alive && (events[i].events & EPOLLIN) ) {
+				alive = this->receive(c) && this->process(c);
+			}
+			if( alive ) {
+				alive = this->send(c);
+			}
+
+			if( alive ) {
+				this->update(c);
+			} else {
+				this->close(c);
+			}
+		}
+	}
+#endif
+}
+
+void LookupServer::accept() {
+#ifndef _WIN32
+	while( true ) {
+		const int fd = accept4(this->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if( fd < 0 ) {
+			return;
+		}
+
+		connection* c = new connection;
+		c->fd = fd;
+		c->written = 0;
+		c->events = EPOLLIN;
+
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = c->events;
+		event.data.ptr = c;
+		if( epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &event) != 0 ) {
+			::close(fd);
+			delete c;
+			continue;
+		}
+
+		this->connections.push_back(c);
+	}
+#endif
+}
+
+/**
+ * Appends what the socket holds to the input buffer
+ * @return false when the client is gone
+ */
+bool LookupServer::receive(connection* c) {
+#ifdef _WIN32
+	return false;
+#else
+	const size_t used = c->input.size();
+	c->input.resize(used + READ_SIZE);
+
+	const ssize_t got = ::read(c->fd, &c->input[used], READ_SIZE);
+	c->input.resize(used + (got > 0 ? got : 0));
+
+	if( got < 0 ) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	return got > 0;
+#endif
+}
+
+/**
+ * Answers all complete requests in the input buffer
+ * @return false on a malformed request
+ */
+bool LookupServer::process(connection* c) {
+	size_t position = 0;
+
+	while( c->input.size() - position >= sizeof(lookupFrame) ) {
+		lookupFrame frame;
+		memcpy(&frame, &c->input[position], sizeof(frame));
+
+		const uint32_t family = frame.family & ~FRAME_UPDATE;
+		const bool updating = (frame.family & FRAME_UPDATE) != 0;
+		if( (family != 4 && family != 6) || frame.count > MAX_COUNT
+			|| (updating && (family == 4 ? this->live == NULL : this->live6 == NULL)) ) {
+			return false;
+		}
+
+		size_t keySize = family == 4 ? sizeof(uint32_t) : sizeof(uint128);
+		if( updating ) {
+			keySize = family == 4 ? sizeof(routeUpdate4) : sizeof(routeUpdate6);
+		}
+		const size_t length = sizeof(frame) + frame.count * keySize;
+		if( c->input.size() - position < length ) {
+			break;
+		}
+
+		const char* keys = &c->input[position + sizeof(frame)];
+		const size_t used = c->output.size();
+		c->output.resize(used + sizeof(frame));
+		memcpy(&c->output[used], &frame, sizeof(frame));
+
+		if( updating && family == 4 ) {
+			this->apply<uint32_t, routeUpdate4>(this->live, this->liveTable, keys, frame.count, c->output);
+		} else if( updating ) {
+			this->apply<uint128, routeUpdate6>(this->live6, this->liveTable6, keys, frame.count, c->output);
+		} else if( family == 4 ) {
+			this->answer(this->engine, this->table, keys, frame.count, c->output);
+		} else {
+			this->answer(this->engine6, this->table6, keys, frame.count, c->output);
+		}
+
+		if( !updating ) {
+			this->_served += frame.count;
+		}
+		position += length;
+	}
+
+	c->input.erase(c->input.begin(), c->input.begin() + position);
+	return true;
+}
+
+/**
+ * Appends AS numbers of the keys, the keys are copied out as the buffer
+ * gives no alignment guarantee
+ */
+template<typename K>
+void LookupServer::answer(const LookupEngine<K>* engine, const AsTable* table, const char* keys, const uint32_t count, vector<char>& output) {
+	K aligned[BATCH_GROUP * 4];
+	unsigned int located[BATCH_GROUP * 4];
+	const uint32_t batch = BATCH_GROUP * 4;
+
+	for(uint32_t done = 0; done < count; done += batch) {
+		const uint32_t size = count - done < batch ? count - done : batch;
+		memcpy(aligned, keys + done * sizeof(K), size * sizeof(K));
+		engine->findBatch(aligned, located, size);
+
+		const size_t used = output.size();
+		output.resize(used + size * sizeof(uint32_t));
+		for(uint32_t i = 0; i < size; ++i) {
+			const uint32_t as = table->as(located[i]);
+			memcpy(&output[used + i * sizeof(uint32_t)], &as, sizeof(as));
+		}
+	}
+}
+
+/**
+ * Applies the updates in order, invalid prefix lengths change nothing
+ */
+template<typename K, typename R>
+void LookupServer::apply(LiveTable<K>* live, AsTable* table, const char* records, const uint32_t count, vector<char>& output) {
+	const size_t used = output.size();
+	output.resize(used + count * sizeof(uint32_t));
+
+	for(uint32_t i = 0; i < count; ++i) {
+		R update;
+		memcpy(&update, records + i * sizeof(R), sizeof(R));
+
+		uint32_t changed = 0;
+		if( update.length <= key_width(update.key) ) {
+			changed = update.as != 0
+				? live->announce(update.key, update.length, update.as, *table)
+				: live->withdraw(update.key, update.length);
+		}
+		memcpy(&output[used + i * sizeof(uint32_t)], &changed, sizeof(changed));
+	}
+}
+
+/**
+ * Writes as much pending output as the socket takes
+ * @return false when the client is gone
+ */
+bool LookupServer::send(connection* c) {
+#ifdef _WIN32
+	return false;
+#else
+	while( c->written < c->output.size() ) {
+		const ssize_t done = ::send(c->fd, &c->output[c->written], c->output.size() - c->written, MSG_NOSIGNAL);
+		if( done < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		c->written += done;
+	}
+
+	c->output.clear();
+	c->written = 0;
+	return true;
+#endif
+}
+
+/**
+ * Waits for output space while anything is pending, stops reading
+ * while too much is
+ */
+void LookupServer::update(connection* c) {
+#ifndef _WIN32
+	const size_t pending = c->output.size() - c->written;
+	const uint32_t events = (pending < MAX_PENDING ? (uint32_t)EPOLLIN : 0u) | (pending > 0 ? (uint32_t)EPOLLOUT : 0u);
+
+	if( events != c->events ) {
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = events;
+		event.data.ptr = c;
+		epoll_ctl(this->epoll, EPOLL_CTL_MOD, c->fd, &event);
+		c->events = events;
+	}
+#endif
+}
+
+void LookupServer::close(connection* c) {
+#ifndef _WIN32
+	epoll_ctl(this->epoll, EPOLL_CTL_DEL, c->fd, NULL);
+	::close(c->fd);
+#endif
+
+	for(unsigned int i = 0; i < this->connections.size(); ++i) {
+		if( this->connections[i] == c ) {
+			this->connections[i] = this->connections.back();
+			this->connections.pop_back();
+			break;
+		}
+	}
+	delete c;
+}
+
+
+LookupClient::LookupClient() {
+	this->fd = -1;
+}
+
+LookupClient::~LookupClient() {
+#ifndef _WIN32
+	if( this->fd >= 0 ) {
+		::close(this->fd);
+	}
+#endif
+}
+
+bool LookupClient::connect(const string& path) {
+#ifdef _WIN32
+	return false;
+#else
+	struct sockaddr_un address;
+
+	if( !make_address(path, address) ) {
+		return false;
+	}
+
+	this->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	return this->fd >= 0 && ::connect(this->fd, (struct sockaddr*)&address, sizeof(address)) == 0;
+#endif
+}
+
+bool LookupClient::query(const uint32_t* keys, uint32_t* results, const uint32_t count) {
+	return this->exchange(4, keys, sizeof(uint32_t), results, count);
+}
+
+bool LookupClient::query(const uint128* keys, uint32_t* results, const uint32_t count) {
+	return this->exchange(6, keys, sizeof(uint128), results, count);
+}
+
+bool LookupClient::update(const routeUpdate4* updates, uint32_t* results, const uint32_t count) {
+	return this->exchange(FRAME_UPDATE | 4, updates, sizeof(routeUpdate4), results, count);
+}
+
+bool LookupClient::update(const routeUpdate6* updates, uint32_t* results, const uint32_t count) {
+	return this->exchange(FRAME_UPDATE | 6, updates, sizeof(routeUpdate6), results, count);
+}
+
+/**
+ * Sends the keys in requests of at most MAX_COUNT, reads the answers
+ */
+bool LookupClient::exchange(const uint32_t family, const void* keys, const size_t keySize, uint32_t* results, const uint32_t count) {
+#ifdef _WIN32
+	return false;
+#else
+	for(uint32_t done = 0; done < count; done += LookupServer::MAX_COUNT) {
+		lookupFrame frame;
+		frame.family = family;
+		frame.count = count - done < LookupServer::MAX_COUNT ? count - done : LookupServer::MAX_COUNT;
+
+		if( !transfer(this->fd, (char*)&frame, sizeof(frame), false)
+			|| !transfer(this->fd, (char*)keys + done * keySize, frame.count * keySize, false) ) {
+			return false;
+		}
+
+		lookupFrame reply;
+		if( !transfer(this->fd, (char*)&reply, sizeof(reply), true) || reply.family != family || reply.count != frame.count ) {
+			return false;
+		}
+		if( !transfer(this->fd, (char*)(results + done), reply.count * sizeof(uint32_t), true) ) {
+			return false;
+		}
+	}
+
+	return true;
+#endif
+}
@@ -0,0 +1,169 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef SERVER_H
+#define	SERVER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "address.h"
+#include "engine.h"
+#include "astable.h"
+#include "live.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * Frame header of the lookup protocol
+ *
+ * A request is the header followed by count keys of the family: uint32_t
+ * for 4, uint128 (high, low) for 6. The response repeats the header and
+ * carries count uint32_t AS numbers, 0 where nothing matched. Everything
+ * is in native byte order, the socket is local. Malformed requests close
+ * the connection.
+ */
+typedef struct lookupFrame {
+	uint32_t family;
+	uint32_t count;
+} lookupFrame;
+
+/** Family flag of update requests */
+const uint32_t FRAME_UPDATE = 0x100;
+
+/**
+ * Route updates, the records of a request with family FRAME_UPDATE | 4
+ * or FRAME_UPDATE | 6
+ *
+ * AS 0 withdraws the prefix, anything else announces it. The response
+ * carries 1 for every update that added or withdrew a prefix, 0 for the
+ * others. Servers without live tables close the connection instead.
+ */
+typedef struct routeUpdate4 {
+	uint32_t key;
+	uint32_t as;
+	uint32_t length;
+} routeUpdate4;
+
+typedef struct routeUpdate6 {
+	uint128 key;
+	uint32_t as;
+	uint32_t length;
+} routeUpdate6;
+
+
+/**
+ * Lookup daemon on a Unix domain socket
+ *
+ * A single epoll loop serves all clients with non-blocking sockets. Whole
+ * requests are answered with one findBatch call each; a client that stops
+ * reading its responses is not read from until its backlog drains.
+ *
+ * The tick handler runs between rounds of events, at least every
+ * TICK_MS; it may switch the tables with use(), requests are never
+ * answered from a mix of two tables.
+ */
+class LookupServer {
+
+	public:
+		static const uint32_t MAX_COUNT = 65536;
+		static const size_t MAX_PENDING = 1 << 22;
+		static const size_t READ_SIZE = 1 << 16;
+		static const unsigned int MAX_EVENTS = 64;
+		static const int TICK_MS = 1000;
+
+		typedef void (*tickHandler)(LookupServer& server, void* context);
+
+		LookupServer(const LookupEngine<uint32_t>* engine, const LookupEngine<uint128>* engine6, const AsTable* table, const AsTable* table6);
+		virtual ~LookupServer();
+
+		void use(const LookupEngine<uint32_t>* engine, const LookupEngine<uint128>* engine6, const AsTable* table, const AsTable* table6);
+		void onTick(tickHandler handler, void* context);
+		void acceptUpdates(LiveTable<uint32_t>* live, LiveTable<uint128>* live6, AsTable* table, AsTable* table6);
+
+		bool listen(const string& path);
+		bool run();
+		void stop();
+
+		unsigned long long served() const;
+
+	private:
+		typedef struct connection {
+			int fd;
+			vector<char> input;
+			vector<char> output;
+			size_t written;
+			uint32_t events;
+		} connection;
+
+		void accept();
+		bool receive(connection* c);
+		bool process(connection* c);
+		bool send(connection* c);
+		void update(connection* c);
+		void close(connection* c);
+
+		template<typename K>
+		void answer(const LookupEngine<K>* engine, const AsTable* table, const char* keys, const uint32_t count, vector<char>& output);
+
+		template<typename K, typename R>
+		void apply(LiveTable<K>* live, AsTable* table, const char* records, const uint32_t count, vector<char>& output);
+
+		const LookupEngine<uint32_t>* engine;
+		const LookupEngine<uint128>* engine6;
+		const AsTable* table;
+		const AsTable* table6;
+
+		LiveTable<uint32_t>* live;
+		LiveTable<uint128>* live6;
+		AsTable* liveTable;
+		AsTable* liveTable6;
+
+		string path;
+		int listener;
+		int epoll;
+		int wakeup[2];
+		vector<connection*> connections;
+
+		tickHandler tick;
+		void* tickContext;
+
+		unsigned long long _served;
+
+};
+
+inline unsigned long long LookupServer::served() const {
+	return this->_served;
+}
+
+
+/**
+ * Blocking client side of the lookup protocol
+ */
+class LookupClient {
+
+	public:
+		LookupClient();
+		virtual ~LookupClient();
+
+		bool connect(const string& path);
+		bool query(const uint32_t* keys, uint32_t* results, const uint32_t count);
+		bool query(const uint128* keys, uint32_t* results, const uint32_t count);
+		bool update(const routeUpdate4* updates, uint32_t* results, const uint32_t count);
+		bool update(const routeUpdate6* updates, uint32_t* results, const uint32_t count);
+
+	private:
+		bool exchange(const uint32_t family, const void* keys, const size_t keySize, uint32_t* results, const uint32_t count);
+
+		int fd;
+
+};
+
+#endif	/* SERVER_H */
@@ -0,0 +1,162 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "shared.h"
+#include <cstring>
+#include <sstream>
+#include <new>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif //WIN32
+
+using std::ostringstream;
+
+const unsigned int SharedTable::ATTACH_ATTEMPTS;
+
+static const char SHARED_MAGIC[8] = {'L', 'P', 'M', 'S', 'H', 'M', '1', '\0'};
+
+
+SharedTable::SharedTable() {
+	this->control = NULL;
+	this->attached = 0;
+}
+
+SharedTable::~SharedTable() {
+	this->detach();
+}
+
+void SharedTable::detach() {
+	this->snapshot4.close();
+	this->snapshot6.close();
+
+#ifndef _WIN32
+	if( this->control != NULL ) {
+		munmap(this->control, sizeof(sharedControl));
+	}
+#endif
+	this->control = NULL;
+	this->attached = 0;
+}
+
+string SharedTable::segmentName(const string& name, const uint64_t generation, const unsigned int family) {
+	ostringstream segment;
+	segment << "/" << name << "." << generation << ".tree" << family;
+	return segment.str();
+}
+
+/**
+ * Maps the control object, writable only for the publisher; a new one
+ * starts at generation 0
+ */
+sharedControl* SharedTable::openControl(const string& name, const bool create) {
+#ifdef _WIN32
+	return NULL;
+#else
+	const string path = "/" + name;
+	const int fd = shm_open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if( fd < 0 ) {
+		return NULL;
+	}
+
+	struct stat info;
+	bool valid = fstat(fd, &info) == 0;
+	const bool fresh = valid && info.st_size == 0;
+	if( fresh && (!create || ftruncate(fd, sizeof(sharedControl)) != 0) ) {
+		valid = false;
+	} else if( valid && !fresh && info.st_size != sizeof(sharedControl) ) {
+		valid = false;
+	}
+
+	void* memory = valid ? mmap(NULL, sizeof(sharedControl), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if( memory == MAP_FAILED ) {
+		return NULL;
+	}
+
+	sharedControl* control = (sharedControl*)memory;
+	if( fresh ) {
+		new (&control->generation) std::atomic<uint64_t>(0);
+		memcpy(control->magic, SHARED_MAGIC, sizeof(control->magic));
+	} else if( memcmp(control->magic, SHARED_MAGIC, sizeof(control->magic)) != 0 ) {
+		munmap(memory, sizeof(sharedControl));
+		return NULL;
+	}
+
+	return control;
+#endif //WIN32
+}
+
+/**
+ * Publishes the tables as the next generation
+ * @param generation set to the published generation
+ */
+bool SharedTable::publish(const string& name, const PatriciaTrie<uint32_t>& trie, const AsTable& table, const PatriciaTrie<uint128>& trie6, const AsTable& table6, uint64_t& generation) {
+#ifdef _WIN32
+	return false;
+#else
+	sharedControl* control = openControl(name, true);
+	if( control == NULL ) {
+		return false;
+	}
+
+	const uint64_t previous = control->generation.load();
+	generation = previous + 1;
+
+	// leftovers of a publisher that died half way
+	shm_unlink(segmentName(name, generation, 4).c_str());
+	shm_unlink(segmentName(name, generation, 6).c_str());
+
+	bool published = snapshot_publish(segmentName(name, generation, 4), trie, table)
+		&& snapshot_publish(segmentName(name, generation, 6), trie6, table6);
+
+	if( published ) {
+		control->generation.store(generation, std::memory_order_release);
+		shm_unlink(segmentName(name, previous, 4).c_str());
+		shm_unlink(segmentName(name, previous, 6).c_str());
+	} else {
+		shm_unlink(segmentName(name, generation, 4).c_str());
+		shm_unlink(segmentName(name, generation, 6).c_str());
+	}
+
+	munmap(control, sizeof(sharedControl));
+	return published;
+#endif //WIN32
+}
+
+/**
+ * Attaches the tries and tables to the newest generation; a generation
+ * unlinked by a concurrent publish is retried with the next one
+ */
+bool SharedTable::attach(const string& name, PatriciaTrie<uint32_t>& trie, AsTable& table, PatriciaTrie<uint128>& trie6, AsTable& table6, const bool verify) {
+	this->detach();
+
+	this->control = openControl(name, false);
+	if( this->control == NULL ) {
+		return false;
+	}
+
+	for(unsigned int attempt = 0; attempt < ATTACH_ATTEMPTS; ++attempt) {
+		const uint64_t generation = this->control->generation.load(std::memory_order_acquire);
+		if( generation == 0 ) {
+			break;
+		}
+
+		if( snapshot_attach(this->snapshot4, segmentName(name, generation, 4), trie, table, verify)
+			&& snapshot_attach(this->snapshot6, segmentName(name, generation, 6), trie6, table6, verify) ) {
+			this->attached = generation;
+			return true;
+		}
+	}
+
+	this->detach();
+	return false;
+}
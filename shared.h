@@ -0,0 +1,85 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef SHARED_H
+#define	SHARED_H
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+#include "patricia.h"
+#include "astable.h"
+#include "snapshot.h"
+
+using std::string;
+
+/**
+ * Control object of a published table, "/name"
+ *
+ * Generation g of the table lives in "/name.g.tree4" and "/name.g.tree6",
+ * snapshots in the usual format whose nodes refer to each other by index,
+ * so every process maps them wherever it likes.
+ */
+typedef struct sharedControl {
+	char magic[8];
+	std::atomic<uint64_t> generation;
+} sharedControl;
+
+/**
+ * Table published in POSIX shared memory
+ *
+ * One loader publishes, any number of processes attach read-only without
+ * copying: the page cache holds the table once. publish() writes a new
+ * generation and then bumps the counter, so attaching processes see
+ * either the old or the new table complete. The previous generation is
+ * unlinked, its memory goes away when the last process detaches.
+ *
+ * Only the mapped Patricia trie is shared. Every other engine is built
+ * from it into private memory of each attaching process, so with those
+ * the memory per process grows with the table.
+ */
+class SharedTable {
+
+	public:
+		static const unsigned int ATTACH_ATTEMPTS = 4;
+
+		SharedTable();
+		virtual ~SharedTable();
+
+		static bool publish(const string& name, const PatriciaTrie<uint32_t>& trie, const AsTable& table, const PatriciaTrie<uint128>& trie6, const AsTable& table6, uint64_t& generation);
+
+		bool attach(const string& name, PatriciaTrie<uint32_t>& trie, AsTable& table, PatriciaTrie<uint128>& trie6, AsTable& table6, const bool verify);
+		void detach();
+
+		bool stale() const;
+		uint64_t generation() const;
+
+	private:
+		static sharedControl* openControl(const string& name, const bool create);
+		static string segmentName(const string& name, const uint64_t generation, const unsigned int family);
+
+		sharedControl* control;
+		Snapshot snapshot4;
+		Snapshot snapshot6;
+		uint64_t attached;
+
+};
+
+inline uint64_t SharedTable::generation() const {
+	return this->attached;
+}
+
+/**
+ * A newer generation has been published since attach()
+ */
+inline bool SharedTable::stale() const {
+	return this->control != NULL && this->control->generation.load(std::memory_order_acquire) != this->attached;
+}
+
+#endif	/* SHARED_H */
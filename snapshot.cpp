@@ -0,0 +1,323 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "snapshot.h"
+#include <fstream>
+#include <cstring>
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif //WIN32
+
+using std::ifstream;
+using std::ofstream;
+using std::ios_base;
+
+const uint32_t Snapshot::VERSION;
+const uint64_t Snapshot::PAYLOAD_OFFSET;
+
+static const char SNAPSHOT_MAGIC[8] = {'L', 'P', 'M', 'S', 'N', 'A', 'P', '\0'};
+static const uint64_t TABLE_ALIGN = 16;
+
+
+Snapshot::Snapshot() {
+	this->mapping = NULL;
+	this->mappingSize = 0;
+	this->mapped = false;
+	this->header = NULL;
+}
+
+Snapshot::~Snapshot() {
+	this->close();
+}
+
+void Snapshot::close() {
+	if( this->mapping != NULL ) {
+#ifndef _WIN32
+		if( this->mapped ) {
+			munmap((void*)this->mapping, this->mappingSize);
+		} else
+#endif //WIN32
+		delete[] this->mapping;
+	}
+
+	this->mapping = NULL;
+	this->mappingSize = 0;
+	this->mapped = false;
+	this->header = NULL;
+}
+
+/**
+ * 64-bit FNV-1a, eight bytes per step
+ */
+uint64_t Snapshot::checksum(const void* data, const uint64_t length) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = 14695981039346656037ull;
+	uint64_t word;
+	uint64_t i = 0;
+
+	for(; i + 8 <= length; i += 8) {
+		memcpy(&word, bytes + i, 8);
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+
+	for(; i < length; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+/**
+ * Fills the header for given payload and table, checksums included
+ */
+void Snapshot::describe(snapshotHeader& h, const uint32_t family, const uint32_t nodeSize, const void* nodes, const uint64_t nodeCount, const uint64_t prefixCount, const asEntry* table, const uint64_t tableCount) {
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	h.version = VERSION;
+	h.family = family;
+	h.nodeSize = nodeSize;
+	h.nodeCount = nodeCount;
+	h.prefixCount = prefixCount;
+	h.payloadOffset = PAYLOAD_OFFSET;
+	h.payloadSize = nodeCount * nodeSize;
+	h.payloadChecksum = checksum(nodes, h.payloadSize);
+	h.tableCount = tableCount;
+	h.tableOffset = (h.payloadOffset + h.payloadSize + TABLE_ALIGN - 1) & ~(uint64_t)(TABLE_ALIGN - 1);
+	h.tableSize = tableCount * sizeof(asEntry);
+	h.tableChecksum = checksum(table, h.tableSize);
+	h.headerChecksum = checksum(&h, offsetof(snapshotHeader, headerChecksum));
+}
+
+#ifndef _WIN32
+/**
+ * Writes the whole buffer, retrying short writes
+ */
+static bool write_all(const int fd, const char* data, uint64_t size) {
+	while( size > 0 ) {
+		const ssize_t written = ::write(fd, data, size);
+		if( written < 0 && errno == EINTR ) {
+			continue;
+		} else if( written <= 0 ) {
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+#endif //WIN32
+
+/**
+ * Writes the snapshot next to path and renames it over path once it is
+ * on disk, so processes still mapping the old file keep an intact copy
+ */
+bool Snapshot::write(const string& path, const uint32_t family, const uint32_t nodeSize, const void* nodes, const uint64_t nodeCount, const uint64_t prefixCount, const asEntry* table, const uint64_t tableCount) {
+	snapshotHeader h;
+	describe(h, family, nodeSize, nodes, nodeCount, prefixCount, table, tableCount);
+
+	char padding[PAYLOAD_OFFSET];
+	memset(padding, 0, sizeof(padding));
+
+#ifdef _WIN32
+	ofstream file(path.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+	if( !file ) {
+		return false;
+	}
+
+	file.write((const char*)&h, sizeof(h));
+	file.write(padding, PAYLOAD_OFFSET - sizeof(h));
+	file.write((const char*)nodes, h.payloadSize);
+	file.write(padding, h.tableOffset - h.payloadOffset - h.payloadSize);
+	file.write((const char*)table, h.tableSize);
+	file.close();
+
+	return !file.fail();
+#else
+	string temporary = path + ".XXXXXX";
+	const int fd = mkstemp(&temporary[0]);
+	if( fd < 0 ) {
+		return false;
+	}
+
+	bool written = fchmod(fd, 0644) == 0
+		&& write_all(fd, (const char*)&h, sizeof(h))
+		&& write_all(fd, padding, PAYLOAD_OFFSET - sizeof(h))
+		&& write_all(fd, (const char*)nodes, h.payloadSize)
+		&& write_all(fd, padding, h.tableOffset - h.payloadOffset - h.payloadSize)
+		&& write_all(fd, (const char*)table, h.tableSize)
+		&& fsync(fd) == 0;
+	written = ::close(fd) == 0 && written;
+
+	if( !written || rename(temporary.c_str(), path.c_str()) != 0 ) {
+		unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+#endif //WIN32
+}
+
+/**
+ * Writes the snapshot into a new POSIX shared memory object
+ * @param name shared memory object name, "/name"; must not exist yet
+ */
+bool Snapshot::publish(const string& name, const uint32_t family, const uint32_t nodeSize, const void* nodes, const uint64_t nodeCount, const uint64_t prefixCount, const asEntry* table, const uint64_t tableCount) {
+#ifdef _WIN32
+	return false;
+#else
+	snapshotHeader h;
+	describe(h, family, nodeSize, nodes, nodeCount, prefixCount, table, tableCount);
+
+	const uint64_t size = h.tableOffset + h.tableSize;
+	const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if( fd < 0 ) {
+		return false;
+	}
+
+	void* memory = MAP_FAILED;
+	if( ftruncate(fd, size) == 0 ) {
+		memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+
+	if( memory == MAP_FAILED ) {
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	// the object is zero filled, padding needs no writes
+	char* target = (char*)memory;
+	memcpy(target, &h, sizeof(h));
+	memcpy(target + h.payloadOffset, nodes, h.payloadSize);
+	memcpy(target + h.tableOffset, table, h.tableSize);
+	munmap(memory, size);
+
+	return true;
+#endif //WIN32
+}
+
+/**
+ * Maps snapshot read-only and validates its header
+ * @param verify check payload checksum too, touches the whole file
+ */
+bool Snapshot::open(const string& path, const uint32_t family, const uint32_t nodeSize, const bool verify) {
+	this->close();
+
+#ifdef _WIN32
+	ifstream file(path.c_str(), ios_base::in | ios_base::binary);
+	if( !file ) {
+		return false;
+	}
+
+	file.seekg(0, ios_base::end);
+	this->mappingSize = file.tellg();
+	file.seekg(0, ios_base::beg);
+
+	char* buffer = new char[this->mappingSize];
+	file.read(buffer, this->mappingSize);
+	this->mapping = buffer;
+
+	if( !file ) {
+		this->close();
+		return false;
+	}
+#else
+	if( !this->map(::open(path.c_str(), O_RDONLY)) ) {
+		return false;
+	}
+#endif //WIN32
+
+	return this->validate(family, nodeSize, verify);
+}
+
+/**
+ * Maps snapshot published in shared memory, see open()
+ */
+bool Snapshot::attach(const string& name, const uint32_t family, const uint32_t nodeSize, const bool verify) {
+	this->close();
+
+#ifdef _WIN32
+	return false;
+#else
+	return this->map(shm_open(name.c_str(), O_RDONLY, 0)) && this->validate(family, nodeSize, verify);
+#endif //WIN32
+}
+
+#ifndef _WIN32
+/**
+ * Maps the whole descriptor read-only and closes it
+ */
+bool Snapshot::map(const int fd) {
+	if( fd < 0 ) {
+		return false;
+	}
+
+	struct stat info;
+	if( fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(snapshotHeader) ) {
+		::close(fd);
+		return false;
+	}
+
+	void* memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if( memory == MAP_FAILED ) {
+		return false;
+	}
+
+	this->mapping = (const char*)memory;
+	this->mappingSize = info.st_size;
+	this->mapped = true;
+	return true;
+}
+#endif //WIN32
+
+/**
+ * Checks the header against the mapping, closes the snapshot when invalid
+ */
+bool Snapshot::validate(const uint32_t family, const uint32_t nodeSize, const bool verify) {
+	const snapshotHeader* h = (const snapshotHeader*)this->mapping;
+
+	bool valid = this->mappingSize >= sizeof(snapshotHeader)
+		&& memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) == 0
+		&& h->headerChecksum == checksum(h, offsetof(snapshotHeader, headerChecksum))
+		&& h->version == VERSION
+		&& h->family == family
+		&& h->nodeSize == nodeSize
+		&& h->nodeCount > 0
+		&& h->payloadSize == h->nodeCount * nodeSize
+		&& h->payloadOffset + h->payloadSize <= this->mappingSize
+		&& h->tableCount > 0
+		&& h->tableSize == h->tableCount * sizeof(asEntry)
+		&& h->tableOffset >= h->payloadOffset + h->payloadSize
+		&& h->tableOffset % TABLE_ALIGN == 0
+		&& h->tableOffset + h->tableSize <= this->mappingSize;
+
+	if( valid && verify ) {
+		valid = h->payloadChecksum == checksum(this->mapping + h->payloadOffset, h->payloadSize)
+			&& h->tableChecksum == checksum(this->mapping + h->tableOffset, h->tableSize);
+	}
+
+	if( !valid ) {
+		this->close();
+		return false;
+	}
+
+	this->header = h;
+	return true;
+}
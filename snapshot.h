@@ -0,0 +1,154 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef SNAPSHOT_H
+#define	SNAPSHOT_H
+
+#include <string>
+#include <stdint.h>
+#include "patricia.h"
+#include "astable.h"
+
+using std::string;
+
+/**
+ * Binary snapshot file header
+ *
+ * The payload is the raw node array of a PatriciaTrie, nodes refer to
+ * each other by index so the file can be mapped and queried in place.
+ * It is followed by the AsTable entries the node values index into.
+ * Values are stored in native byte order, a foreign snapshot fails the
+ * version check and gets regenerated.
+ */
+typedef struct snapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t family;
+	uint32_t nodeSize;
+	uint32_t reserved;
+	uint64_t nodeCount;
+	uint64_t prefixCount;
+	uint64_t payloadOffset;
+	uint64_t payloadSize;
+	uint64_t payloadChecksum;
+	uint64_t tableCount;
+	uint64_t tableOffset;
+	uint64_t tableSize;
+	uint64_t tableChecksum;
+	uint64_t headerChecksum;
+} snapshotHeader;
+
+class Snapshot {
+
+	public:
+		static const uint32_t VERSION = 2;
+		static const uint64_t PAYLOAD_OFFSET = 128;
+
+		Snapshot();
+		virtual ~Snapshot();
+
+		bool open(const string& path, const uint32_t family, const uint32_t nodeSize, const bool verify);
+		bool attach(const string& name, const uint32_t family, const uint32_t nodeSize, const bool verify);
+		void close();
+
+		const void* payload() const;
+		uint64_t nodeCount() const;
+		uint64_t prefixCount() const;
+		const asEntry* table() const;
+		uint64_t tableCount() const;
+
+		static bool write(const string& path, const uint32_t family, const uint32_t nodeSize, const void* nodes, const uint64_t nodeCount, const uint64_t prefixCount, const asEntry* table, const uint64_t tableCount);
+		static bool publish(const string& name, const uint32_t family, const uint32_t nodeSize, const void* nodes, const uint64_t nodeCount, const uint64_t prefixCount, const asEntry* table, const uint64_t tableCount);
+		static uint64_t checksum(const void* data, const uint64_t length);
+
+	private:
+		static void describe(snapshotHeader& h, const uint32_t family, const uint32_t nodeSize, const void* nodes, const uint64_t nodeCount, const uint64_t prefixCount, const asEntry* table, const uint64_t tableCount);
+		bool map(const int fd);
+		bool validate(const uint32_t family, const uint32_t nodeSize, const bool verify);
+
+		const char* mapping;
+		uint64_t mappingSize;
+		bool mapped;
+
+		const snapshotHeader* header;
+
+};
+
+inline const void* Snapshot::payload() const {
+	return this->mapping + this->header->payloadOffset;
+}
+
+inline uint64_t Snapshot::nodeCount() const {
+	return this->header->nodeCount;
+}
+
+inline uint64_t Snapshot::prefixCount() const {
+	return this->header->prefixCount;
+}
+
+inline const asEntry* Snapshot::table() const {
+	return (const asEntry*)(this->mapping + this->header->tableOffset);
+}
+
+inline uint64_t Snapshot::tableCount() const {
+	return this->header->tableCount;
+}
+
+
+/**
+ * Writes trie nodes and their AS table as snapshot
+ */
+template<typename K>
+bool snapshot_save(const string& path, const PatriciaTrie<K>& trie, const AsTable& table) {
+	return Snapshot::write(path, key_width(K()), sizeof(typename PatriciaTrie<K>::patriciaNode), trie.data(), trie.nodeCount(), trie.count(), table.data(), table.count());
+}
+
+/**
+ * Publishes trie nodes and their AS table as shared memory snapshot
+ */
+template<typename K>
+bool snapshot_publish(const string& name, const PatriciaTrie<K>& trie, const AsTable& table) {
+	return Snapshot::publish(name, key_width(K()), sizeof(typename PatriciaTrie<K>::patriciaNode), trie.data(), trie.nodeCount(), trie.count(), table.data(), table.count());
+}
+
+/**
+ * Opens snapshot and attaches the trie and table to it, the snapshot has to stay open
+ */
+template<typename K>
+bool snapshot_load(Snapshot& snapshot, const string& path, PatriciaTrie<K>& trie, AsTable& table, const bool verify) {
+	if( !snapshot.open(path, key_width(K()), sizeof(typename PatriciaTrie<K>::patriciaNode), verify) ) {
+		return false;
+	}
+
+	if( !trie.attach((const typename PatriciaTrie<K>::patriciaNode*)snapshot.payload(), snapshot.nodeCount(), snapshot.prefixCount(), snapshot.tableCount()) ) {
+		snapshot.close();
+		return false;
+	}
+	table.attach(snapshot.table(), snapshot.tableCount());
+	return true;
+}
+
+/**
+ * Like snapshot_load, for a snapshot published in shared memory
+ */
+template<typename K>
+bool snapshot_attach(Snapshot& snapshot, const string& name, PatriciaTrie<K>& trie, AsTable& table, const bool verify) {
+	if( !snapshot.attach(name, key_width(K()), sizeof(typename PatriciaTrie<K>::patriciaNode), verify) ) {
+		return false;
+	}
+
+	if( !trie.attach((const typename PatriciaTrie<K>::patriciaNode*)snapshot.payload(), snapshot.nodeCount(), snapshot.prefixCount(), snapshot.tableCount()) ) {
+		snapshot.close();
+		return false;
+	}
+	table.attach(snapshot.table(), snapshot.tableCount());
+	return true;
+}
+
+#endif	/* SNAPSHOT_H */
@@ -0,0 +1,180 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include "live.h"
+#include "astable.h"
+
+using std::vector;
+using std::map;
+using std::pair;
+using std::thread;
+
+/**
+ * Concurrent reader/writer check of LiveTable
+ *
+ * One writer announces and withdraws prefixes, every announce with an AS
+ * never seen before, so the AS table grows all the time. Readers keep
+ * looking up meanwhile: every answer must be an AS whose prefix covers
+ * the key, the default route keeps answers from ever being empty. At the
+ * end the table is compared to a brute-force model. Build with
+ * -fsanitize=address or -fsanitize=thread to catch memory reuse.
+ */
+
+static const unsigned int OPERATIONS = 200000;
+static const unsigned int READERS = 3;
+static const unsigned int DEFAULT_AS = 1;
+static const unsigned int FIRST_AS = 1000;
+
+typedef struct origin {
+	uint32_t key;
+	unsigned int length;
+} origin;
+
+/** Prefix of every AS ever announced, written before the announce */
+static vector<origin> origins(FIRST_AS + OPERATIONS);
+
+static std::atomic<bool> running(true);
+static std::atomic<unsigned long long> failures(0);
+static std::atomic<unsigned long long> lookups(0);
+
+static uint64_t next_random(uint64_t& state) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
+
+/**
+ * Keys from a few /8s, so that prefixes nest and overlap
+ */
+static uint32_t random_key(uint64_t& state) {
+	const uint64_t r = next_random(state);
+	return (uint32_t)(((r >> 32) & 0x0F) << 24) | (uint32_t)(r & 0xFFFFFF);
+}
+
+static bool covers(const uint32_t key, const origin& o) {
+	return o.length == 0 || ((key ^ o.key) >> (32 - o.length)) == 0;
+}
+
+static bool valid_answer(const uint32_t key, const unsigned int as) {
+	return as == DEFAULT_AS || (as >= FIRST_AS && as < origins.size() && covers(key, origins[as]));
+}
+
+static void reader(const LiveTable<uint32_t>* live, const AsTable* table, const unsigned int seed) {
+	uint64_t state = 0x9E3779B97F4A7C15ULL * (seed + 1);
+	uint32_t keys[BATCH_GROUP];
+	unsigned int located[BATCH_GROUP];
+	unsigned long long done = 0;
+
+	while( running.load() ) {
+		const uint32_t key = random_key(state);
+		if( !valid_answer(key, table->as(live->find(key))) ) {
+			failures++;
+		}
+
+		for(unsigned int i = 0; i < BATCH_GROUP; ++i) {
+			keys[i] = random_key(state);
+		}
+		live->findBatch(keys, located, BATCH_GROUP);
+		for(unsigned int i = 0; i < BATCH_GROUP; ++i) {
+			if( !valid_answer(keys[i], table->as(located[i])) ) {
+				failures++;
+			}
+		}
+
+		done += BATCH_GROUP + 1;
+	}
+
+	lookups += done;
+}
+
+static unsigned int model_find(const map<pair<uint32_t, unsigned int>, unsigned int>& model, const uint32_t key) {
+	for(int length = 32; length >= 0; --length) {
+		const uint32_t masked = length == 0 ? 0 : key & (0xFFFFFFFFu << (32 - length));
+		map<pair<uint32_t, unsigned int>, unsigned int>::const_iterator it = model.find(std::make_pair(masked, (unsigned int)length));
+		if( it != model.end() ) {
+			return it->second;
+		}
+	}
+	return 0;
+}
+
+int main() {
+	LiveTable<uint32_t> live;
+	AsTable table;
+	map<pair<uint32_t, unsigned int>, unsigned int> model;
+	vector<pair<uint32_t, unsigned int> > announced;
+	uint64_t state = 42;
+
+	live.announce(0, 0, DEFAULT_AS, table);
+	model[std::make_pair(0u, 0u)] = DEFAULT_AS;
+
+	vector<thread> readers;
+	for(unsigned int r = 0; r < READERS; ++r) {
+		readers.push_back(thread(reader, &live, &table, r));
+	}
+
+	for(unsigned int op = 0; op < OPERATIONS; ++op) {
+		if( !announced.empty() && next_random(state) % 5 < 2 ) {
+			const unsigned int index = next_random(state) % announced.size();
+			const pair<uint32_t, unsigned int> prefix = announced[index];
+			announced[index] = announced.back();
+			announced.pop_back();
+
+			if( live.withdraw(prefix.first, prefix.second) != (model.erase(prefix) == 1) ) {
+				failures++;
+			}
+			continue;
+		}
+
+		const unsigned int length = 8 + next_random(state) % 21;
+		const uint32_t key = random_key(state) & (0xFFFFFFFFu << (32 - length));
+		const unsigned int as = FIRST_AS + op;
+		origins[as].key = key;
+		origins[as].length = length;
+
+		const pair<uint32_t, unsigned int> prefix(key, length);
+		const bool added = model.find(prefix) == model.end();
+		if( live.announce(key, length, as, table) != added ) {
+			failures++;
+		}
+		if( added ) {
+			announced.push_back(prefix);
+		}
+		model[prefix] = as;
+	}
+
+	running.store(false);
+	for(unsigned int r = 0; r < readers.size(); ++r) {
+		readers[r].join();
+	}
+
+	// quiescent comparison with the model
+	unsigned long long mismatches = 0;
+	for(unsigned int i = 0; i < 1000000; ++i) {
+		const uint32_t key = random_key(state);
+		if( table.as(live.find(key)) != model_find(model, key) ) {
+			mismatches++;
+		}
+	}
+	if( live.count() != model.size() ) {
+		mismatches++;
+	}
+
+	printf("%u updates, %llu concurrent lookups, %llu wrong answers, %llu model mismatches, %u prefixes, %u AS numbers\n",
+		OPERATIONS, lookups.load(), failures.load(), mismatches, live.count(), table.count() - 1);
+
+	return failures.load() == 0 && mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
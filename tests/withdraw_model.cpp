@@ -0,0 +1,207 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include "tree.h"
+#include "live.h"
+#include "astable.h"
+
+using std::string;
+using std::vector;
+using std::map;
+using std::pair;
+
+/**
+ * Randomized insert/remove check of the withdrawal paths
+ *
+ * Churns the legacy RadixTrie and the LiveTable behind lpm -u with the
+ * same random announces and withdrawals and compares both against a
+ * model every thousand steps: same content, consistent parent links and no
+ * node left without data and with a single child. The LiveTable must
+ * also end up with exactly the nodes of a table built from scratch.
+ */
+
+static const unsigned int OPERATIONS = 200000;
+static const unsigned int CHECK_EVERY = 1000;
+
+typedef map<pair<uint32_t, unsigned int>, unsigned int> prefixModel;
+
+static unsigned long long failures = 0;
+
+static uint64_t next_random(uint64_t& state) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
+
+static string to_bits(const uint32_t key, const unsigned int length) {
+	string bits;
+	for(unsigned int i = 0; i < length; ++i) {
+		bits += (key >> (31 - i)) & 1 ? '1' : '0';
+	}
+	return bits;
+}
+
+static void fail(const char* what, const unsigned int op) {
+	if( failures++ < 10 ) {
+		fprintf(stderr, "operation %u: %s\n", op, what);
+	}
+}
+
+/**
+ * Collects the data nodes of the subtree and verifies its shape
+ */
+static void walk_radix(const node* n, const node* parent, map<string, unsigned int>& content, unsigned int& nodes, const unsigned int op) {
+	nodes++;
+
+	if( n->parent != parent ) {
+		fail("radix: broken parent link", op);
+	}
+	if( parent != NULL && (n->length <= parent->length || string(n->key, parent->length) != string(parent->key, parent->length)) ) {
+		fail("radix: child does not extend its parent", op);
+	}
+	if( parent != NULL && !n->data && n->childrenCount < 2 ) {
+		fail("radix: node without data and with less than two children", op);
+	}
+	if( n->data ) {
+		content[string(n->key, n->length)] = n->as;
+	}
+
+	for(unsigned char i = 0; i < n->childrenCount; ++i) {
+		walk_radix(n->children[i], n, content, nodes, op);
+	}
+}
+
+static unsigned int check_radix(RadixTrie& trie, const prefixModel& model, const unsigned int op) {
+	map<string, unsigned int> content;
+	unsigned int nodes = 0;
+	walk_radix(trie.getRoot(), NULL, content, nodes, op);
+
+	map<string, unsigned int> expected;
+	for(prefixModel::const_iterator it = model.begin(); it != model.end(); ++it) {
+		expected[to_bits(it->first.first, it->first.second)] = it->second;
+	}
+
+	if( content != expected ) {
+		fail("radix: content differs from the model", op);
+	}
+
+	return nodes;
+}
+
+static unsigned int model_find(const prefixModel& model, const uint32_t key) {
+	for(int length = 32; length >= 0; --length) {
+		const uint32_t masked = length == 0 ? 0 : key & (0xFFFFFFFFu << (32 - length));
+		prefixModel::const_iterator it = model.find(std::make_pair(masked, (unsigned int)length));
+		if( it != model.end() ) {
+			return it->second;
+		}
+	}
+	return 0;
+}
+
+static void check_live(const LiveTable<uint32_t>& live, const AsTable& table, const prefixModel& model, uint64_t& state, const unsigned int op) {
+	if( live.count() != model.size() ) {
+		fail("live: prefix count differs from the model", op);
+	}
+
+	for(unsigned int i = 0; i < 1000; ++i) {
+		const uint32_t key = (uint32_t)(next_random(state) & 0x0FFFFFFF);
+		if( table.as(live.find(key)) != model_find(model, key) ) {
+			fail("live: lookup differs from the model", op);
+			break;
+		}
+	}
+
+	// a compressed trie is unique for its prefixes
+	AsTable fresh;
+	vector<prefixEntry<uint32_t> > prefixes;
+	for(prefixModel::const_iterator it = model.begin(); it != model.end(); ++it) {
+		prefixEntry<uint32_t> entry;
+		entry.key = it->first.first;
+		entry.length = it->first.second;
+		entry.value = fresh.intern(it->second);
+		prefixes.push_back(entry);
+	}
+
+	LiveTable<uint32_t> rebuilt;
+	rebuilt.build(prefixes);
+	if( live.size() != rebuilt.size() ) {
+		fail("live: node count differs from a fresh build", op);
+	}
+}
+
+int main() {
+	RadixTrie trie;
+	LiveTable<uint32_t> live;
+	AsTable table;
+	prefixModel model;
+	vector<pair<uint32_t, unsigned int> > announced;
+	uint64_t state = 7;
+	unsigned int nodes = 0;
+
+	for(unsigned int op = 0; op < OPERATIONS; ++op) {
+		// keep the table around a few hundred prefixes so that removals hit
+		// every shape: leaves, inner data nodes and split points
+		const bool withdraw = !announced.empty() && next_random(state) % 1000 < 400 + announced.size() / 2;
+
+		if( withdraw ) {
+			const unsigned int index = next_random(state) % announced.size();
+			const pair<uint32_t, unsigned int> prefix = announced[index];
+			announced[index] = announced.back();
+			announced.pop_back();
+
+			const string bits = to_bits(prefix.first, prefix.second);
+			if( !trie.remove(bits) ) {
+				fail("radix: present prefix not removed", op);
+			}
+			if( !live.withdraw(prefix.first, prefix.second) ) {
+				fail("live: present prefix not withdrawn", op);
+			}
+			model.erase(prefix);
+
+			// second removal must find nothing
+			if( trie.remove(bits) || live.withdraw(prefix.first, prefix.second) ) {
+				fail("absent prefix removed", op);
+			}
+		} else {
+			const unsigned int length = 1 + next_random(state) % 32;
+			const uint32_t key = (uint32_t)(next_random(state) & 0x0FFFFFFF) & (0xFFFFFFFFu << (32 - length));
+			const unsigned int as = 1 + next_random(state) % 50;
+
+			const pair<uint32_t, unsigned int> prefix(key, length);
+			const bool added = model.find(prefix) == model.end();
+			if( (trie.insert(to_bits(key, length), as) != NULL) != added ) {
+				fail("radix: insert reported a wrong outcome", op);
+			}
+			if( live.announce(key, length, as, table) != added ) {
+				fail("live: announce reported a wrong outcome", op);
+			}
+			if( added ) {
+				announced.push_back(prefix);
+			}
+			model[prefix] = as;
+		}
+
+		if( op % CHECK_EVERY == 0 || op + 1 == OPERATIONS ) {
+			nodes = check_radix(trie, model, op);
+			check_live(live, table, model, state, op);
+		}
+	}
+
+	printf("%u operations, %u prefixes left, %u radix nodes, %llu failures\n",
+		OPERATIONS, (unsigned int)model.size(), nodes, failures);
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#include "topology.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#ifndef _WIN32
+#include <sched.h>
+#endif //WIN32
+
+using std::ifstream;
+using std::ostringstream;
+using std::string;
+
+/**
+ * Parses a sysfs CPU list, e.g. "0-3,8-11"
+ */
+static bool parse_cpulist(const string& list, vector<unsigned int>& cpus) {
+	const char* p = list.c_str();
+
+	while( *p != '\0' && *p != '\n' ) {
+		char* end;
+		const unsigned long first = strtoul(p, &end, 10);
+		if( end == p ) {
+			return false;
+		}
+
+		unsigned long last = first;
+		p = end;
+		if( *p == '-' ) {
+			last = strtoul(p + 1, &end, 10);
+			if( end == p + 1 || last < first ) {
+				return false;
+			}
+			p = end;
+		}
+
+		for(unsigned long cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(cpu);
+		}
+
+		if( *p == ',' ) {
+			p++;
+		}
+	}
+
+	return true;
+}
+
+
+Topology::Topology() {
+	// node numbers may have holes, stop after a few missing ones in a row
+	for(unsigned int id = 0, missing = 0; missing < 8; ++id) {
+		ostringstream path;
+		path << "/sys/devices/system/node/node" << id << "/cpulist";
+
+		ifstream file(path.str().c_str());
+		string list;
+		if( !file || !std::getline(file, list) ) {
+			missing++;
+			continue;
+		}
+		missing = 0;
+
+		// memory-only nodes have an empty list
+		numaNode node;
+		node.id = id;
+		if( parse_cpulist(list, node.cpus) && !node.cpus.empty() ) {
+			this->list.push_back(node);
+		}
+	}
+
+	if( this->list.empty() ) {
+		this->list.resize(1);
+		this->list[0].id = 0;
+	}
+}
+
+/**
+ * Restricts the calling thread to the CPUs of the node
+ */
+bool Topology::bind(const unsigned int node) const {
+#ifdef _WIN32
+	return false;
+#else
+	const vector<unsigned int>& cpus = this->list[node % this->list.size()].cpus;
+	if( cpus.empty() ) {
+		return false;
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(unsigned int i = 0; i < cpus.size(); ++i) {
+		if( cpus[i] < CPU_SETSIZE ) {
+			CPU_SET(cpus[i], &set);
+		}
+	}
+
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif //WIN32
+}
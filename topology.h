@@ -0,0 +1,68 @@
+/**
+ * VUT FIT Brno: PDS
+ *
+ * Longest-Prefix Match
+ *
+ * Jiri Petruzelka
+ * <xpetru07>
+ * 2012/2013
+ */
+#ifndef TOPOLOGY_H
+#define	TOPOLOGY_H
+
+#include <vector>
+
+using std::vector;
+
+/**
+ * NUMA nodes of the machine, read from sysfs
+ *
+ * Memory is placed on the node of the thread that first touches it, so a
+ * table built by a thread bound to a node ends up local to it; no libnuma
+ * needed. Machines without NUMA (or without sysfs) look like one node
+ * holding every CPU.
+ *
+ * Nodes are indexed from 0 in the order of their kernel numbers, which
+ * may have holes; id() gives the kernel number of an index. Memory-only
+ * nodes are not listed as no worker can run there.
+ */
+class Topology {
+
+	public:
+		Topology();
+
+		unsigned int nodes() const;
+		unsigned int node(const unsigned int worker) const;
+		unsigned int id(const unsigned int node) const;
+
+		bool bind(const unsigned int node) const;
+
+	private:
+		typedef struct numaNode {
+			unsigned int id;
+			vector<unsigned int> cpus;
+		} numaNode;
+
+		vector<numaNode> list;
+
+};
+
+inline unsigned int Topology::nodes() const {
+	return this->list.size();
+}
+
+/**
+ * Workers are spread over the nodes round robin
+ */
+inline unsigned int Topology::node(const unsigned int worker) const {
+	return worker % this->list.size();
+}
+
+/**
+ * Kernel number of the node, as in /sys/devices/system/node/nodeN
+ */
+inline unsigned int Topology::id(const unsigned int node) const {
+	return this->list[node % this->list.size()].id;
+}
+
+#endif	/* TOPOLOGY_H */
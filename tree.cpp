@@ -17,11 +17,10 @@
 #ifdef _WIN32
 #include <windows.h>
 #else
-#include <sys/time.h>
+#include <time.h>
 #endif //WIN32
 #include <math.h>
 
-#define ALLOC_BLOCK 3
 #define DEBUG 1
 
 using std::cout;
@@ -33,6 +32,9 @@ using std::ios_base;
 #define MAX(a,b) (a > b ? a : b)
 #define ROUND(x, n) (floor(MAX(0,x) * pow(10,n)) / pow(10,n))
 
+const unsigned int RadixTrie::SHORT_KEY;
+const unsigned int RadixTrie::LONG_KEY;
+
 /* zdroj: gmu1 */
 double getTime(void)
 {
@@ -54,68 +56,127 @@ double getTime(void)
     return (double)value.QuadPart / (double)frequency.QuadPart;  			/* vrat hodnotu v sekundach */
 
 #else                                         							/* toto jede na Linux/Unixovych systemech */
-    struct timeval tv;
-    if (gettimeofday(&tv, NULL) == -1) {        							/* vezmi cas */
-        //assert(0 && "gettimeofday does not work.");  						/* osetri chyby */
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {        				/* vezmi cas, monotonni */
         exit(-2);
     }
-    return (double)tv.tv_sec + (double)tv.tv_usec/1000000.;  				/* vrat cas v sekundach */
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1000000000.;  			/* vrat cas v sekundach */
 #endif
 }
 /* /zdroj: gmu1 */
 
 
 RadixTrie::RadixTrie() {
-	this->root = new node;
-	this->root->prefix = string("");
-	this->root->parent = NULL;
-	this->root->childrenCount = 0;
-	this->root->content = string("");
-	this->root->data = false;
-	this->root->as = 0;
 	this->allocation = NULL;
+	this->staticRoot = NULL;
+	this->init();
+}
+
+RadixTrie::~RadixTrie() {
+	delete[] this->allocation;
+}
+
+void RadixTrie::init() {
+	this->root = this->createNode("", 0, 0, false);
 
 	this->_size = 0;
 #if DEBUG
 	this->_nodes = 0;
-	this->_alloc = 0;
 #endif
 }
 
-RadixTrie::~RadixTrie() {
-	this->clear();
-}
-
+/**
+ * Frees all nodes at once, the trie stays usable
+ */
 void RadixTrie::clear() {
 	if( this->allocation != NULL ) {
 		delete[] this->allocation;
 		this->allocation = NULL;
-		delete this->root;
-	} else if( this->root != NULL ) {
-		this->clearNode(this->root);
 	}
 
-	this->root = NULL;
+	this->arena.clear();
+	this->freeNodes.clear();
+	this->freeKeys[0].clear();
+	this->freeKeys[1].clear();
+	this->init();
 }
 
-void RadixTrie::clearNode(node* node) {
-	if( node == NULL ) {
-#if DEBUG
-		this->_size--;
-#endif
-		return;
+node* RadixTrie::createNode(const char* key, const unsigned int length, const unsigned int as, const bool data) {
+	node* n;
+	if( this->freeNodes.empty() ) {
+		n = (node*)this->arena.alloc(sizeof(node));
+	} else {
+		n = this->freeNodes.back();
+		this->freeNodes.pop_back();
 	}
 
-	for(unsigned char i=0;i<node->childrenCount;i++) {
-		this->clearNode(node->children[i]);
+	n->key = key;
+	n->length = length;
+	n->parent = NULL;
+	n->childrenCount = 0;
+	n->as = as;
+	n->data = data;
+	n->ownsKey = false;
+	return n;
+}
+
+/**
+ * Copies key into a buffer of its size class, reusing released ones
+ */
+char* RadixTrie::createKey(const char* data, const unsigned int length) {
+	if( length > LONG_KEY ) {
+		return this->arena.copy(data, length);
 	}
 
-	delete node;
+	vector<char*>& recycled = this->freeKeys[length > SHORT_KEY];
+	char* key;
+	if( recycled.empty() ) {
+		key = (char*)this->arena.alloc(length > SHORT_KEY ? LONG_KEY : SHORT_KEY);
+	} else {
+		key = recycled.back();
+		recycled.pop_back();
+	}
+
+	memcpy(key, data, length);
+	return key;
+}
+
+/**
+ * Recycles node taken out of the tree, its key passes to the nearest
+ * ancestor still sharing it
+ */
+void RadixTrie::releaseNode(node* n, node* formerParent) {
+	if( n->ownsKey ) {
+		node* heir = formerParent;
+		while( heir != NULL && heir->key != n->key ) {
+			heir = heir->parent;
+		}
+
+		if( heir != NULL ) {
+			heir->ownsKey = true;
+		} else if( n->length <= LONG_KEY ) {
+			this->freeKeys[n->length > SHORT_KEY].push_back((char*)n->key);
+		}
+	}
+
+	this->freeNodes.push_back(n);
 #if DEBUG
 	this->_size--;
 #endif
 }
 
+void RadixTrie::replaceChild(node* parent, node* child, node* replacement) {
+	for(unsigned char i = 0; i < parent->childrenCount; i++) {
+		if( parent->children[i] == child ) {
+			parent->children[i] = replacement;
+			break;
+		}
+	}
+
+	child->parent = NULL;
+	replacement->parent = parent;
+}
+
 
 void RadixTrie::serialize(ostream& stream, node* root, unsigned int* total) {
 	(*total)++;
@@ -124,7 +185,9 @@ void RadixTrie::serialize(ostream& stream, node* root, unsigned int* total) {
 		stream << RadixTrie::SEP_META << this->count() << RadixTrie::SEP_META;
 	}
 
-	stream << root->prefix << RadixTrie::SEP;
+	const unsigned int offset = root->parent == NULL ? 0 : root->parent->length;
+	stream.write(root->key + offset, root->length - offset);
+	stream << RadixTrie::SEP;
 	stream << root->as << RadixTrie::SEP_CHILD_START;
 	for(unsigned char i=0;i<root->childrenCount;++i) {
 		serialize(stream, root->children[i], total);
@@ -149,6 +212,7 @@ void RadixTrie::parseFrom(istream& stream, const unsigned short bufferSize) {
 
 void RadixTrie::parseElement(istream& stream, staticNode* parent, const unsigned short bufferSize) {
 	staticNode* newNode;
+	char as[11];
 
 	while(stream.good()) {
 
@@ -160,8 +224,9 @@ void RadixTrie::parseElement(istream& stream, staticNode* parent, const unsigned
 
 			stream.getline(newNode->staticPrefix, bufferSize, RadixTrie::SEP);
 			newNode->prefixSize = strlen(newNode->staticPrefix);
-			stream.getline(newNode->as, 9, RadixTrie::SEP_CHILD_START);
-			newNode->isData = (bool)(newNode->as[0] != '0');
+			stream.getline(as, sizeof(as), RadixTrie::SEP_CHILD_START);
+			newNode->as = (unsigned int)strtoul(as, NULL, 10);
+			newNode->isData = newNode->as != 0;
 
 			parent->children[parent->childrenCount++] = newNode;
 			this->_size++;
@@ -180,7 +245,7 @@ void RadixTrie::parseElement(istream& stream, staticNode* parent, const unsigned
 
 			this->staticRoot = new staticNode;
 			this->staticRoot->childrenCount = 0;
-			strcpy(this->staticRoot->as, "0");
+			this->staticRoot->as = 0;
 			this->staticRoot->prefixSize = 0;
 			this->staticRoot->isData = false;
 
@@ -228,120 +293,133 @@ void RadixTrie::detachChild(node* parent, node* child) {
 	}
 }
 
-unsigned int RadixTrie::matchingCharacters(const string& first, const string& second) {
-	unsigned int length = first.size();
-	if( second.size() < length ) {
-		length = second.size();
-	}
+/**
+ * Inserts '0'/'1' string of given length, returns the new node or NULL
+ * when the prefix was already present and only its AS got replaced
+ */
+node* RadixTrie::insert(const char* data, const unsigned int length, const unsigned int as) {
+	node* parent = this->root;
+
+	while( true ) {
+		const unsigned int matching = matchingCharacters(data, length, parent->key, parent->length);
+
+		// already present, or a split point that becomes a prefix now
+		if( matching == length && length == parent->length ) {
+			const bool present = parent->data;
+			parent->as = as;
+			parent->data = true;
+			return present ? NULL : parent;
+		}
 
-	const char* str1 = first.c_str();
-	const char* str2 = second.c_str();
+		// matching but smaller - insert above parent, sharing its key
+		if( matching == length ) {
+			node* newNode = this->createNode(parent->key, length, as, true);
 
-	unsigned int i;
-	for(i = 0; i < length; ++i) {
-		if( str1[i] != str2[i] ) {
-			return i;
+			node *originalParent = parent->parent;
+			detachChild(originalParent, parent);
+			addChild(originalParent, newNode);
+			addChild(newNode, parent);
+			return newNode;
 		}
-	}
 
-	return length;
-}
+		// matching but larger - descend into child continuing with the same bit
+		if( matching == parent->length ) {
+			node* next = NULL;
+			for(unsigned char i = 0; i < parent->childrenCount; i++) {
+				if( parent->children[i]->key[matching] == data[matching] ) {
+					next = parent->children[i];
+					break;
+				}
+			}
+
+			if( next != NULL ) {
+				parent = next;
+				continue;
+			}
+
+			node* newNode = this->createNode(this->createKey(data, length), length, as, true);
+			newNode->ownsKey = true;
+			addChild(parent, newNode);
+			return newNode;
+		}
 
-node* RadixTrie::insert(const string data, const unsigned int as, node* parent) {
-	if( parent->content == data ) {
-		parent->as = as;
-		parent->data = true;
-		return NULL;
+		// matching but partially - split
+		node *originalParent = parent->parent;
+		detachChild(originalParent, parent);
+
+		node* newParent = this->createNode(parent->key, matching, 0, false);
+		node* newNode = this->createNode(this->createKey(data, length), length, as, true);
+		newNode->ownsKey = true;
+
+		addChild(originalParent, newParent);
+		addChild(newParent, parent);
+		addChild(newParent, newNode);
+#if DEBUG
+		this->_size -= 1;
+		this->_nodes -= 2;
+#endif
+		return newNode;
 	}
+}
 
-	node* newNode;
-	newNode = new node;
-	newNode->parent = NULL;
-	newNode->childrenCount = 0;
-	newNode->as = as;
-	newNode->content = data;
-	newNode->data = true;
 
-	unsigned int matchingParent = matchingCharacters(newNode->content, parent->content);
 
-	// no match
-	if( matchingParent == 0 ) {
+/**
+ * Withdraws '0'/'1' string of given length, returns false when not present
+ *
+ * Nodes left without data and with less than two children are merged away
+ * so the tree stays path-compressed.
+ */
+bool RadixTrie::remove(const char* data, const unsigned int length) {
+	node* current = this->root;
 
-		for(unsigned char i = 0; i < parent->childrenCount; i++) {
-			// matches child - insert lower
-			if( matchingCharacters(newNode->content, parent->children[i]->content) > 0 ) {
-				delete newNode;
-				return insert(data, as, parent->children[i]);
-			}
-		}
+	while( true ) {
+		const unsigned int matching = matchingCharacters(data, length, current->key, current->length);
 
-		// no match in children nor parent
-		newNode->prefix = data;
-		addChild(parent, newNode);
-	}
-	// matching but smaller
-	else if( matchingParent == data.size() && data.size() < parent->content.size() ){
-
-		for(unsigned char i = 0; i < parent->childrenCount; i++) {
-			// matches child - insert lower
-			if( matchingParent < matchingCharacters(newNode->content, parent->children[i]->content) ) {
-				delete newNode;
-				return insert(data, as, parent->children[i]);
-			}
+		if( matching == length && length == current->length ) {
+			break;
 		}
 
-		parent->prefix = parent->content.substr(data.size(), parent->prefix.size());
+		if( matching != current->length || matching == length ) {
+			return false;
+		}
 
-		node *originalParent = parent->parent;
-		detachChild(originalParent, parent);
-		addChild(originalParent, newNode);
-		newNode->prefix = data.substr(newNode->parent->content.size(), data.size() - newNode->parent->content.size());
-		addChild(newNode, parent);
-	}
-	// matching but larger
-	else if( matchingParent == parent->content.size() && parent->content.size() < newNode->content.size() ) {
-
-		for(unsigned char i = 0; i < parent->childrenCount; i++) {
-			// matches child - insert lower
-			if( matchingParent < matchingCharacters(newNode->content, parent->children[i]->content) ) {
-				delete newNode;
-				return insert(data, as, parent->children[i]);
+		node* next = NULL;
+		for(unsigned char i = 0; i < current->childrenCount; i++) {
+			if( current->children[i]->key[matching] == data[matching] ) {
+				next = current->children[i];
+				break;
 			}
 		}
 
-		// larger but matches no child - insert and split
-		newNode->prefix = newNode->content.substr(parent->content.size(), newNode->content.size()).c_str();
-		addChild(parent, newNode);
+		if( next == NULL ) {
+			return false;
+		}
+		current = next;
 	}
-	// matching but partially
-	else {
 
-		node *originalParent = parent->parent;
-		detachChild(originalParent, parent);
+	if( !current->data ) {
+		return false;
+	}
 
-		node* newParent = new node;
-		newParent->parent = NULL;
-		newParent->childrenCount = 0;
-		newParent->as = 0;
-		newParent->content = parent->content.substr(0, matchingParent);
-		newParent->data = false;
+	current->data = false;
+	current->as = 0;
 
-		addChild(originalParent, newParent);
-		int size = matchingParent - parent->content.size() + parent->prefix.size();
+	// drop nodes that carry nothing, at most the node and its parent
+	while( current != this->root && !current->data && current->childrenCount < 2 ) {
+		node* parent = current->parent;
 
-		newParent->prefix = parent->prefix.substr(0, size);
-		parent->prefix = parent->prefix.substr(size, parent->prefix.size());
-		newNode->prefix = newNode->content.substr(matchingParent, newNode->content.size());
+		if( current->childrenCount == 1 ) {
+			this->replaceChild(parent, current, current->children[0]);
+		} else {
+			this->detachChild(parent, current);
+		}
 
-		addChild(newParent, parent);
-		addChild(newParent, newNode);
-#if DEBUG
-		this->_size -= 1;
-		this->_nodes -= 2;
-#endif
+		this->releaseNode(current, parent);
+		current = parent;
 	}
 
-	return newNode;
+	return true;
 }
 
 
@@ -361,10 +439,15 @@ void RadixTrie::dumpNode(node* node, unsigned int level, bool full) {
 
 	if( node == this->root ) {
 		cout << "ROOT" << endl;
-	} else if( node->data == false ) {
-		cout << " " << (full ? node->content : node->prefix) << " [node]" << std::endl;
 	} else {
-		cout << " " << (full ? node->content : node->prefix) << " => " << node->as << std::endl;
+		const unsigned int offset = full ? 0 : node->parent->length;
+		cout << " ";
+		cout.write(node->key + offset, node->length - offset);
+		if( node->data == false ) {
+			cout << " [node]" << std::endl;
+		} else {
+			cout << " => " << node->as << std::endl;
+		}
 	}
 
 	for(unsigned char i=0;i<node->childrenCount;i++) {
@@ -405,7 +488,8 @@ void RadixTrie::printAsNodes(unsigned int as, node* root) {
 	}
 
 	if( root->as == as ) {
-		cout << root->content << endl;
+		cout.write(root->key, root->length);
+		cout << endl;
 	}
 
 	for(unsigned char i=0;i<root->childrenCount;i++) {
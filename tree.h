@@ -16,6 +16,7 @@
 #include <vector>
 #include <stdlib.h>
 #include <cstring>
+#include "arena.h"
 
 using std::string;
 using std::vector;
@@ -27,30 +28,43 @@ using std::endl;
 
 double getTime();
 
+/**
+ * Dynamic tree node, lives in the trie arena
+ *
+ * key holds the bits from the root, only the first length of them belong
+ * to the node; the edge label is the part past the parent length. Split
+ * nodes share the key of the node they were split from, the deepest node
+ * using a key buffer owns it.
+ */
 typedef struct node {
-	string content;
-	string prefix;
+	const char* key;
+	unsigned char length;
 	struct node* children[2];
 	struct node* parent;
 	unsigned char childrenCount;
 	unsigned int as;
 	bool data;
+	bool ownsKey;
 } node;
 
 typedef struct staticNode {
-	char staticPrefix[116];
+	char staticPrefix[129];
 	unsigned char prefixSize;
 
 	struct staticNode* children[2];
 	struct staticNode* staticParent;
 	unsigned char childrenCount;
-	char as[9];
+	unsigned int as;
 
 	bool isData;
 } staticNode;
 
-const unsigned int allockBlock = sizeof(node) * 3;
-
+/**
+ * Dynamic '0'/'1' string radix tree
+ *
+ * Legacy, no lookup path uses it anymore; -g builds the PatriciaTrie
+ * directly and live updates go to LiveTable.
+ */
 class RadixTrie {
 
 	public:
@@ -58,12 +72,16 @@ class RadixTrie {
 		static const char SEP_META = '_';
 		static const char SEP_CHILD_START = '<';
 		static const char SEP_CHILD_END = '>';
+		static const unsigned int SHORT_KEY = 32;
+		static const unsigned int LONG_KEY = 128;
 
 		RadixTrie();
 		virtual ~RadixTrie();
 
-		node* insert(const string data, const unsigned int as);
-		node* insert(const string data, const unsigned int as, node* parent);
+		node* insert(const string& data, const unsigned int as);
+		node* insert(const char* data, const unsigned int length, const unsigned int as);
+		bool remove(const string& data);
+		bool remove(const char* data, const unsigned int length);
 		void clear();
 		void dump();
 		void dumpFull();
@@ -82,15 +100,18 @@ class RadixTrie {
 		void printAsNodes(unsigned int as, node* root);
 
 	private:
-		void clearNode(node* node);
+		void init();
+		node* createNode(const char* key, const unsigned int length, const unsigned int as, const bool data);
+		char* createKey(const char* data, const unsigned int length);
+		void releaseNode(node* n, node* formerParent);
+		void replaceChild(node* parent, node* child, node* replacement);
 
 		void dumpNode(node* node, unsigned int level, bool full);
 		void addChild(node* parent, node* child);
 		void addChildFast(node* parent, node* child);
 		void detachChild(node* parent, node* child);
 
-		unsigned int matchingCharacters(const string& first, const string& second);
-		unsigned int matchingPrefix(const string& first, const string& second, const unsigned int start);
+		unsigned int matchingCharacters(const char* first, const unsigned int firstLength, const char* second, const unsigned int secondLength);
 
 		void parseElement(istream& stream, staticNode* parent, const unsigned short bufferSize);
 
@@ -98,8 +119,10 @@ class RadixTrie {
 		staticNode* staticRoot;
 		int _size;
 		unsigned int _nodes;
-		unsigned int _alloc;
 		staticNode* allocation;
+		Arena arena;
+		vector<node*> freeNodes;
+		vector<char*> freeKeys[2];
 
 };
 
@@ -107,8 +130,12 @@ inline staticNode* RadixTrie::find(const char* data) {
 	return findNode(this->staticRoot, data, 0);
 }
 
-inline node* RadixTrie::insert(const string data, const unsigned int as) {
-	return insert(data, as, this->root);
+inline node* RadixTrie::insert(const string& data, const unsigned int as) {
+	return insert(data.c_str(), data.size(), as);
+}
+
+inline bool RadixTrie::remove(const string& data) {
+	return remove(data.c_str(), data.size());
 }
 
 inline int RadixTrie::count() {
@@ -120,7 +147,7 @@ inline unsigned int RadixTrie::nodeCount() {
 }
 
 inline int RadixTrie::size() {
-	return this->_alloc * sizeof(node);
+	return this->arena.size();
 }
 
 inline node* RadixTrie::getRoot() {
@@ -138,18 +165,12 @@ inline void RadixTrie::addChildFast(node* parent, node* child) {
 	this->_size++;
 }
 
-inline unsigned int RadixTrie::matchingPrefix(const string& first, const string& second, const unsigned int start) {
-	unsigned int length = first.size();
-	if( second.size() < length ) {
-		length = second.size();
-	}
-
-	const char* str1 = first.c_str();
-	const char* str2 = second.c_str();
+inline unsigned int RadixTrie::matchingCharacters(const char* first, const unsigned int firstLength, const char* second, const unsigned int secondLength) {
+	const unsigned int length = firstLength < secondLength ? firstLength : secondLength;
 
 	unsigned int i;
-	for(i = start; i < length; ++i) {
-		if( str1[i] != str2[i] ) {
+	for(i = 0; i < length; ++i) {
+		if( first[i] != second[i] ) {
 			return i;
 		}
 	}
@@ -161,7 +182,7 @@ inline staticNode* RadixTrie::findNode(staticNode* from, const char* data, const
 	staticNode* node = NULL;
 
 	// compare
-	for(unsigned char i = 0; i < from->childrenCount; ++i)
+	for(unsigned char i = 0; i < from->childrenCount; ++i) {
 		node = from->children[i];
 
 		if( data[precalcMatchedParent] == node->staticPrefix[0] ) {